@@ -67,6 +67,7 @@
 #define LIME_METHOD_UNKNOWN 0
 #define LIME_METHOD_TCP 1
 #define LIME_METHOD_DISK 2
+#define LIME_METHOD_FD 3
 
 
 #undef LIME_DEBUG
@@ -94,16 +95,83 @@ typedef struct {
 #define __LIMEIO        0xAF
 
 #define LIME_GET_STATUS         _IO(__LIMEIO, 1) /* Get status of driver */
-#define LIME_DUMP_TCP		_IO(__LIMEIO, 2) /* Dump memory to socket */
-#define LIME_DUMP_DISK		_IO(__LIMEIO, 3) /* Dump memory to disk */
+#define LIME_DUMP_TCP		_IOW(__LIMEIO, 2, lime_dump_tcp) /* Dump memory to socket */
+#define LIME_DUMP_DISK		_IOW(__LIMEIO, 3, lime_dump_disk) /* Dump memory to disk */
+#define LIME_DUMP_PROC		_IOW(__LIMEIO, 4, lime_dump_proc) /* Dump pages mapped by processes */
+#define LIME_GET_RAM_MAP	_IOR(__LIMEIO, 5, lime_ram_map) /* Describe "System RAM" */
+#define LIME_DUMP_FD		_IOW(__LIMEIO, 6, lime_dump_fd) /* Dump memory to an open fd */
 
 #define LIME_STATUS_READY       0x1
 #define LIME_STATUS_BUSY        0x0
 
+#define LIME_TRIAGE_OFF		0 /* Full "System RAM" walk */
+#define LIME_TRIAGE_FIRST	1 /* Kernel ranges, then the full walk */
+#define LIME_TRIAGE_ONLY	2 /* Kernel ranges only */
+
+#define LIME_ORDER_PHYSICAL	0 /* Ascending physical address */
+#define LIME_ORDER_VOLATILITY	1 /* Most volatile memory first */
+
+#define LIME_CIPHER_NONE		0
+#define LIME_CIPHER_AES_GCM		1 /* AES-256-GCM */
+#define LIME_CIPHER_CHACHA20_POLY1305	2 /* Kernels 4.2 and newer */
+
+#define LIME_KEY_SIZE		32
+
+/* Range classes, stored in reserved[0] of lime_mem_range_header */
+#define LIME_RANGE_RAM		0
+#define LIME_RANGE_KTEXT	1
+#define LIME_RANGE_KDATA	2
+#define LIME_RANGE_SLAB		3
+#define LIME_RANGE_KRODATA	4 /* _etext to _sdata: rodata and __init */
+#define LIME_RANGE_RECAPTURE	5 /* Changed while the dump was running */
+
+#define LIME_MAX_PATTERNS	16
+#define LIME_MAX_PATTERN_LEN	64
+
+typedef struct {
+	unsigned int len;
+	unsigned char data[LIME_MAX_PATTERN_LEN];
+} lime_pattern;
+
+#define LIME_MAX_RANGES		64
+
+typedef struct {
+	unsigned long long start;
+	unsigned long long end;		/* Inclusive */
+} lime_range;
+
+typedef struct {
+	int count;
+	lime_range ranges[LIME_MAX_RANGES];
+	unsigned long long size_raw;	/* Expected image size per format */
+	unsigned long long size_padded;
+	unsigned long long size_lime;
+} lime_ram_map;
+
+/* Options common to every dump request */
+typedef struct {
+	int triage;
+	int pattern_count;
+	lime_pattern patterns[LIME_MAX_PATTERNS];
+	int entropy;
+	int smear;
+	int order;
+	int cipher;
+	unsigned char key[LIME_KEY_SIZE];
+	int window_count;		/* Only dump "System RAM" inside these */
+	lime_range windows[LIME_MAX_RANGES];
+	int pfn_meta;			/* Emit LIME_META_PFN records */
+	int boot;			/* Emit a LIME_META_BOOT record first */
+	int zram;			/* Index zram objects, record swap ptes */
+
+} lime_dump_opts;
+
 typedef struct {
 	char file_name[LIME_MAX_FILENAME_SIZE];
 	int mode;
 	int dio;
+	lime_dump_opts opts;
+	unsigned long long segment_size;	/* 0 for a single file */
 
 } lime_dump_disk;
 
@@ -111,8 +179,189 @@ typedef struct {
 	int port;
 	int mode;
 	int dio;
+	lime_dump_opts opts;
 
 } lime_dump_tcp;
+
+typedef struct {
+	int fd;
+	int mode;
+	lime_dump_opts opts;
+
+} lime_dump_fd;
+
+#define LIME_MAX_PIDS		16
+
+typedef struct {
+	int method;
+	char file_name[LIME_MAX_FILENAME_SIZE];
+	int port;
+	int mode;
+	int dio;
+	int pid_count;
+	int pids[LIME_MAX_PIDS];
+	lime_dump_opts opts;
+
+} lime_dump_proc;
+
+/* Metadata records. These are only emitted in LIME_MODE_LIME, and are
+ * interleaved with the lime_mem_range_header records. Readers tell them
+ * apart by magic and skip "size" bytes of payload to get to the next one. */
+#define LIME_META_MAGIC 0x4C694D4D //LiMM
+
+#define LIME_META_VMA		1 /* lime_vma_entry[] */
+#define LIME_META_PTE		2 /* lime_pte_entry[] */
+#define LIME_META_HITS		3 /* lime_hit_entry[] */
+#define LIME_META_ENTROPY	4 /* lime_entropy_entry[] */
+#define LIME_META_SMEAR		5 /* lime_smear_entry[] */
+#define LIME_META_PFN		6 /* lime_pfn_header, then its columns */
+#define LIME_META_BOOT		7 /* lime_boot_entry */
+#define LIME_META_ZRAM		8 /* lime_zram_header, then lime_zram_entry[] */
+
+#define LIME_META_TRUNCATED	0x1 /* Entries were dropped */
+
+/* Granularity at which per-segment metadata is flushed */
+#define LIME_SEGMENT_SIZE	(4 << 20)
+
+/* Granularity of per-chunk statistics */
+#define LIME_CHUNK_SIZE		(64 << 10)
+
+/* Largest piece of lowmem read through the direct map at once */
+#define LIME_SPAN_SIZE		(2 << 20)
+
+/* Content classes in lime_entropy_entry */
+#define LIME_CONTENT_ZERO	0
+#define LIME_CONTENT_TEXT	1
+#define LIME_CONTENT_CODE	2
+#define LIME_CONTENT_DATA	3
+#define LIME_CONTENT_COMPRESSED	4
+#define LIME_CONTENT_ENCRYPTED	5
+
+/* Page classes in the class column of a LIME_META_PFN record */
+#define LIME_PFN_OTHER		0
+#define LIME_PFN_KERNEL		1 /* Reserved */
+#define LIME_PFN_SLAB		2
+#define LIME_PFN_ANON		3
+#define LIME_PFN_FILE		4 /* Page cache */
+#define LIME_PFN_FREE		5 /* Owned by the buddy allocator */
+
+typedef struct {
+	unsigned int magic;
+	unsigned int version;
+	unsigned int type;
+	unsigned int flags;
+	unsigned long long size;
+	unsigned char reserved[8];
+} __attribute__ ((__packed__)) lime_meta_header;
+
+typedef struct {
+	int pid;
+	unsigned int flags;		/* vm_flags */
+	unsigned long long start;
+	unsigned long long end;
+	unsigned long long pgoff;
+} __attribute__ ((__packed__)) lime_vma_entry;
+
+/* Swapped out pages, recorded when indexing zram, carry LIME_PTE_SWAP
+ * and the swap type in flags, and the swap offset in paddr. */
+#define LIME_PTE_SWAP		0x1
+#define LIME_PTE_SWAP_TYPE(f)	((f) >> 8)
+
+typedef struct {
+	int pid;
+	unsigned int flags;
+	unsigned long long vaddr;
+	unsigned long long paddr;
+} __attribute__ ((__packed__)) lime_pte_entry;
+
+typedef struct {
+	unsigned long long paddr;	/* First byte of the match */
+	unsigned int pattern;
+	unsigned int reserved;
+} __attribute__ ((__packed__)) lime_hit_entry;
+
+typedef struct {
+	unsigned long long paddr;
+	unsigned int size;
+	unsigned short entropy;		/* Bits per byte, 8.8 fixed point */
+	unsigned char zero;		/* Fraction of zero bytes, out of 255 */
+	unsigned char class;		/* LIME_CONTENT_* */
+} __attribute__ ((__packed__)) lime_entropy_entry;
+
+typedef struct {
+	unsigned long long paddr;
+	unsigned int size;
+	unsigned int captured;		/* Milliseconds since the dump started */
+	unsigned int recaptured;
+	unsigned int reserved;
+} __attribute__ ((__packed__)) lime_smear_entry;
+
+/* A LIME_META_PFN record describes count consecutive pfns starting at pfn.
+ * The header is followed by one column per field, each count entries long:
+ *     unsigned int flags[count];	page->flags, low 32 bits
+ *     int mapcount[count];
+ *     unsigned char order[count];	Buddy or compound order, on the head
+ *     unsigned char class[count];	LIME_PFN_* */
+typedef struct {
+	unsigned long long pfn;
+	unsigned int count;
+	unsigned int page_shift;
+} __attribute__ ((__packed__)) lime_pfn_header;
+
+#define LIME_BANNER_SIZE	256
+
+typedef struct {
+	unsigned long long pgd_paddr;	/* swapper_pg_dir */
+	unsigned long long page_offset;
+	unsigned long long text_vaddr;	/* _text */
+	unsigned long long text_paddr;
+	unsigned long long kaslr_offset;	/* 0 when not randomized or unknown */
+	unsigned long long init_task_vaddr;
+	unsigned long long init_task_paddr;
+	unsigned int page_shift;
+	unsigned int pointer_size;
+	char banner[LIME_BANNER_SIZE];	/* linux_banner */
+} __attribute__ ((__packed__)) lime_boot_entry;
+
+#define LIME_ZRAM_ZERO		0x1 /* Zero filled, no object */
+#define LIME_ZRAM_SPLIT		0x2 /* No single address, see klime_zram.c */
+
+typedef struct {
+	unsigned int device;		/* zramN */
+	unsigned int count;
+	int swap_type;			/* Type in swap ptes, -1 if not swap */
+	char compressor[16];
+} __attribute__ ((__packed__)) lime_zram_header;
+
+typedef struct {
+	unsigned long long paddr;	/* Compressed object */
+	unsigned int index;		/* Slot, the swap offset when used as swap */
+	unsigned int size;		/* PAGE_SIZE when stored uncompressed */
+	unsigned short flags;
+	unsigned short reserved;
+} __attribute__ ((__packed__)) lime_zram_entry;
+
+/* Encrypted streams. A lime_crypt_header is followed by frames of at most
+ * frame_size bytes of the plain stream, each sealed with the key given in
+ * lime_dump_opts and followed by a 16 byte tag. */
+#define LIME_CRYPT_MAGIC 0x4C694D43 //LiMC
+#define LIME_CRYPT_FRAME	(64 << 10)
+#define LIME_CRYPT_FINAL	0x80000000 /* Set in len of the last frame */
+#define LIME_CRYPT_TAG		16
+
+typedef struct {
+	unsigned int magic;
+	unsigned int version;
+	unsigned int cipher;
+	unsigned int frame_size;
+	unsigned char salt[8];
+	unsigned char reserved[8];
+} __attribute__ ((__packed__)) lime_crypt_header;
+
+typedef struct {
+	unsigned int index;
+	unsigned int len;
+} __attribute__ ((__packed__)) lime_crypt_frame;
 /* End added */
 
 #endif //__LIME_H_
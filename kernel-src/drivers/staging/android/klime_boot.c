@@ -0,0 +1,88 @@
+/*
+ * LiME - Linux Memory Extractor
+ * Copyright (c) 2011-2013 Joe Sylve - 504ENSICS Labs
+ *
+ *
+ * Author(s):
+ * Joe Sylve       - joe.sylve@gmail.com, @jtsylve
+ * Jake Valletta   - javallet@gmail.com, @jake_valletta
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/* This fork of LiME allows Android applications and programs
+ * in userspace the ability to arbitrarily dump system memory using a
+ * device driver. All credit for LiME functionality goes to Joe;
+ * I simply created an API around it.
+ *
+ * A NOTE ON SECURITY:
+ * This initial fork of LiME lacks any UAC or security model.  The driver
+ * is accessible to userspace and applications.  Any application or
+ * program can link against the LiME code and potentially dump memory.
+ * This will be addressed in further releases.
+ *
+ * TL;DR - Don't install this on a production ROM (yet)!!!!!
+ */
+
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/version.h>
+
+#include <asm/sections.h>
+#ifdef CONFIG_X86
+#include <asm/setup.h>
+#endif
+
+#include "klime.h"
+
+/* The analysis bootstrap record. Values every analysis otherwise has to
+ * recover by scanning the image (the kernel page table root, where the
+ * kernel and init_task sit and the KASLR slide) are read off the running
+ * kernel and written as a LIME_META_BOOT record ahead of any memory. */
+
+int write_boot(void);
+
+extern int write_meta(unsigned int, unsigned int, void *, size_t);
+
+extern const char linux_banner[];
+extern struct task_struct init_task;
+extern struct mm_struct init_mm;
+
+int write_boot() {
+	lime_boot_entry boot;
+
+	memset(&boot, 0, sizeof(lime_boot_entry));
+
+	// init_mm.pgd is swapper_pg_dir on every architecture
+	boot.pgd_paddr = __pa(init_mm.pgd);
+	boot.page_offset = PAGE_OFFSET;
+	boot.text_vaddr = (unsigned long) _text;
+	boot.text_paddr = __pa(_text);
+	boot.init_task_vaddr = (unsigned long) &init_task;
+	boot.init_task_paddr = __pa(&init_task);
+	boot.page_shift = PAGE_SHIFT;
+	boot.pointer_size = sizeof(void *);
+
+#if defined(CONFIG_RANDOMIZE_BASE) && LINUX_VERSION_CODE >= KERNEL_VERSION(4,8,0) && \
+    (defined(CONFIG_X86) || defined(CONFIG_ARM64))
+	boot.kaslr_offset = kaslr_offset();
+#endif
+
+	strlcpy(boot.banner, linux_banner, sizeof(boot.banner));
+
+	return write_meta(LIME_META_BOOT, 0, &boot, sizeof(lime_boot_entry));
+}
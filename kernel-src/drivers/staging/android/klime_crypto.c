@@ -0,0 +1,326 @@
+/*
+ * LiME - Linux Memory Extractor
+ * Copyright (c) 2011-2013 Joe Sylve - 504ENSICS Labs
+ *
+ *
+ * Author(s):
+ * Joe Sylve       - joe.sylve@gmail.com, @jtsylve
+ * Jake Valletta   - javallet@gmail.com, @jake_valletta
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/* This fork of LiME allows Android applications and programs
+ * in userspace the ability to arbitrarily dump system memory using a
+ * device driver. All credit for LiME functionality goes to Joe;
+ * I simply created an API around it.
+ *
+ * A NOTE ON SECURITY:
+ * This initial fork of LiME lacks any UAC or security model.  The driver
+ * is accessible to userspace and applications.  Any application or
+ * program can link against the LiME code and potentially dump memory.
+ * This will be addressed in further releases.
+ *
+ * TL;DR - Don't install this on a production ROM (yet)!!!!!
+ */
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/random.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
+#include <linux/scatterlist.h>
+#include <linux/crypto.h>
+#include <crypto/aead.h>
+
+#include <asm/byteorder.h>
+
+#include "klime.h"
+
+/* Stream encryption. Everything headed for the sink is cut into frames of
+ * LIME_CRYPT_FRAME bytes, and each frame is sealed with an AEAD from the
+ * kernel crypto API (AES-256-GCM, or ChaCha20-Poly1305 where the kernel has
+ * it). Frames are encrypted by an unbound workqueue, several at a time, and
+ * written to the sink strictly in order as they come back. The layout is
+ *
+ *     lime_crypt_header
+ *     lime_crypt_frame, ciphertext, 16 byte tag
+ *     ...
+ *     lime_crypt_frame (LIME_CRYPT_FINAL), ciphertext, 16 byte tag
+ *
+ * The nonce is the random salt from the header followed by the big endian
+ * frame index, and the frame header is authenticated along with the data,
+ * so frames can't be dropped, reordered or truncated unnoticed. */
+
+int setup_crypto(int, unsigned char *);
+int finish_crypto(void);
+void cleanup_crypto(void);
+int write_vaddr_crypto(void *, size_t);
+
+extern int write_sink(void *, size_t);
+
+#define LIME_CRYPT_FRAMES	4
+#define LIME_CRYPT_BUF		(sizeof(lime_crypt_frame) + LIME_CRYPT_FRAME + LIME_CRYPT_TAG)
+
+struct lime_frame {
+	struct work_struct work;
+	struct completion done;
+	struct aead_request * req;
+	struct scatterlist sg;
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4,2,0)
+	struct scatterlist assoc;
+#endif
+	u8 iv[12];
+	char * buf;
+	size_t len;
+	int busy;
+	int err;
+};
+
+struct lime_crypt_wait {
+	struct completion done;
+	int err;
+};
+
+static struct crypto_aead * tfm = NULL;
+static struct workqueue_struct * crypt_wq = NULL;
+static struct lime_frame frames[LIME_CRYPT_FRAMES];
+static int cur_frame = 0;
+static unsigned int frame_index = 0;
+static unsigned char salt[8];
+
+static void crypt_done(struct crypto_async_request * req, int err) {
+	struct lime_crypt_wait * wait = req->data;
+
+	// Only a notification that a backlogged request has started
+	if (err == -EINPROGRESS)
+		return;
+
+	wait->err = err;
+	complete(&wait->done);
+}
+
+static void encrypt_work(struct work_struct * work) {
+	struct lime_frame * f = container_of(work, struct lime_frame, work);
+	struct lime_crypt_wait wait;
+	size_t hdr = sizeof(lime_crypt_frame);
+	int r;
+
+	init_completion(&wait.done);
+	aead_request_set_callback(f->req, CRYPTO_TFM_REQ_MAY_BACKLOG | CRYPTO_TFM_REQ_MAY_SLEEP,
+				  crypt_done, &wait);
+
+	// Encrypted in place, the tag lands right after the ciphertext
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,2,0)
+	sg_init_one(&f->sg, f->buf, hdr + f->len + LIME_CRYPT_TAG);
+	aead_request_set_ad(f->req, hdr);
+#else
+	sg_init_one(&f->assoc, f->buf, hdr);
+	sg_init_one(&f->sg, f->buf + hdr, f->len + LIME_CRYPT_TAG);
+	aead_request_set_assoc(f->req, &f->assoc, hdr);
+#endif
+	aead_request_set_crypt(f->req, &f->sg, &f->sg, f->len, f->iv);
+
+	r = crypto_aead_encrypt(f->req);
+
+	if (r == -EINPROGRESS || r == -EBUSY) {
+		wait_for_completion(&wait.done);
+		r = wait.err;
+	}
+
+	f->err = r;
+	complete(&f->done);
+}
+
+/* Wait for a frame to be sealed and pass it on to the sink. */
+static int retire_frame(struct lime_frame * f) {
+	size_t total = sizeof(lime_crypt_frame) + f->len + LIME_CRYPT_TAG;
+	int s;
+
+	if (!f->busy)
+		return 0;
+
+	wait_for_completion(&f->done);
+	f->busy = 0;
+	f->len = 0;
+
+	if (f->err) {
+		DBG("Error encrypting frame %d", f->err);
+		return f->err;
+	}
+
+	s = write_sink(f->buf, total);
+
+	if (s != total) {
+		DBG("Error sending frame %d", s);
+		return (s < 0) ? s : -EIO;
+	}
+
+	return 0;
+}
+
+static int submit_frame(int final) {
+	struct lime_frame * f = &frames[cur_frame];
+	lime_crypt_frame * hdr = (lime_crypt_frame *) f->buf;
+	__be32 index = cpu_to_be32(frame_index);
+
+	hdr->index = frame_index++;
+	hdr->len = f->len | (final ? LIME_CRYPT_FINAL : 0);
+
+	memcpy(f->iv, salt, sizeof(salt));
+	memcpy(f->iv + sizeof(salt), &index, sizeof(index));
+
+	f->busy = 1;
+	init_completion(&f->done);
+	INIT_WORK(&f->work, encrypt_work);
+	queue_work(crypt_wq, &f->work);
+
+	// Make sure the next slot in the ring is free to fill
+	cur_frame = (cur_frame + 1) % LIME_CRYPT_FRAMES;
+
+	return retire_frame(&frames[cur_frame]);
+}
+
+int setup_crypto(int cipher, unsigned char * key) {
+	lime_crypt_header header;
+	const char * alg;
+	int i, s, err;
+
+	switch (cipher) {
+	case LIME_CIPHER_AES_GCM:
+		alg = "gcm(aes)";
+		break;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,2,0)
+	case LIME_CIPHER_CHACHA20_POLY1305:
+		alg = "rfc7539(chacha20,poly1305)";
+		break;
+#endif
+	default:
+		return -EINVAL;
+	}
+
+	tfm = crypto_alloc_aead(alg, 0, 0);
+	if (IS_ERR(tfm)) {
+		err = PTR_ERR(tfm);
+		DBG("Couldn't allocate %s %d", alg, err);
+		tfm = NULL;
+		return err;
+	}
+
+	err = crypto_aead_setkey(tfm, key, LIME_KEY_SIZE);
+	memset(key, 0, LIME_KEY_SIZE);
+
+	if (err || (err = crypto_aead_setauthsize(tfm, LIME_CRYPT_TAG)))
+		return err;
+
+	crypt_wq = alloc_workqueue("lime_crypt", WQ_UNBOUND, LIME_CRYPT_FRAMES);
+	if (!crypt_wq)
+		return -ENOMEM;
+
+	for (i = 0; i < LIME_CRYPT_FRAMES; i++) {
+		frames[i].len = 0;
+		frames[i].busy = 0;
+		frames[i].buf = kmalloc(LIME_CRYPT_BUF, GFP_KERNEL);
+		frames[i].req = aead_request_alloc(tfm, GFP_KERNEL);
+
+		if (!frames[i].buf || !frames[i].req)
+			return -ENOMEM;
+	}
+
+	cur_frame = 0;
+	frame_index = 0;
+	get_random_bytes(salt, sizeof(salt));
+
+	memset(&header, 0, sizeof(lime_crypt_header));
+	header.magic = LIME_CRYPT_MAGIC;
+	header.version = 1;
+	header.cipher = cipher;
+	header.frame_size = LIME_CRYPT_FRAME;
+	memcpy(header.salt, salt, sizeof(salt));
+
+	s = write_sink(&header, sizeof(lime_crypt_header));
+
+	if (s != sizeof(lime_crypt_header)) {
+		DBG("Error sending encryption header %d", s);
+		return (s < 0) ? s : -EIO;
+	}
+
+	return 0;
+}
+
+/* Seal whatever is left as the final frame and drain the ring in order. */
+int finish_crypto() {
+	int i, err, ret;
+
+	ret = submit_frame(1);
+
+	for (i = 0; i < LIME_CRYPT_FRAMES; i++) {
+		err = retire_frame(&frames[(cur_frame + i) % LIME_CRYPT_FRAMES]);
+		if (!ret)
+			ret = err;
+	}
+
+	return ret;
+}
+
+void cleanup_crypto() {
+	int i;
+
+	if (crypt_wq) {
+		flush_workqueue(crypt_wq);
+		destroy_workqueue(crypt_wq);
+		crypt_wq = NULL;
+	}
+
+	for (i = 0; i < LIME_CRYPT_FRAMES; i++) {
+		if (frames[i].req)
+			aead_request_free(frames[i].req);
+
+		// Plaintext RAM doesn't get left lying around in the heap
+		if (frames[i].buf) {
+			memset(frames[i].buf, 0, LIME_CRYPT_BUF);
+			kfree(frames[i].buf);
+		}
+
+		frames[i].req = NULL;
+		frames[i].buf = NULL;
+		frames[i].busy = 0;
+	}
+
+	if (tfm)
+		crypto_free_aead(tfm);
+
+	tfm = NULL;
+}
+
+int write_vaddr_crypto(void * v, size_t is) {
+	struct lime_frame * f;
+	size_t done = 0, n;
+	int err;
+
+	while (done < is) {
+		f = &frames[cur_frame];
+
+		n = min_t(size_t, is - done, LIME_CRYPT_FRAME - f->len);
+		memcpy(f->buf + sizeof(lime_crypt_frame) + f->len, (char *) v + done, n);
+
+		f->len += n;
+		done += n;
+
+		if (f->len == LIME_CRYPT_FRAME && (err = submit_frame(0)))
+			return err;
+	}
+
+	return is;
+}
@@ -35,18 +35,71 @@
  *
  * TL;DR - Don't install this on a production ROM (yet)!!!!!
  */
+#include <linux/fs.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
+#include <linux/mutex.h>
+#include <linux/ktime.h>
+
 #include "klime.h"
+#include "klime_trace.h"
 
 
 int write_vaddr_disk(void *, size_t);
 int setup_disk(void);
+int finish_disk(void);
 void cleanup_disk(void);
+void note_range_disk(resource_size_t, resource_size_t);
 
 static void disable_dio(void);
 
+static int setup_segments(void);
+static int finish_segments(void);
+static void cleanup_segments(void);
+static int write_vaddr_segments(void *, size_t);
+
 static struct file * f = NULL;
 extern char * path;
 extern int dio;
+extern unsigned long long segment_size;
+
+/* Segmented output. The image is split across "<path>.000", "<path>.001",
+ * ... each preallocated to segment_size, so nothing grows extent by extent
+ * and no file crosses the 4 GB FAT limit. Data is copied into a ring of
+ * buffers which are written out by an unbound workqueue, so copying and
+ * writing overlap and several segments can be written at once. A text
+ * "<path>.manifest" records the segments and where each physical range
+ * landed in the image. */
+#define LIME_DISK_BUFS		4
+#define LIME_DISK_BUF_ORDER	6
+#define LIME_DISK_BUF_SIZE	(PAGE_SIZE << LIME_DISK_BUF_ORDER)
+#define LIME_MAX_SEGMENTS	1024
+
+struct lime_disk_buf {
+	struct work_struct work;
+	struct completion done;
+	char * data;
+	size_t len;
+	int seg;
+	loff_t pos;
+};
+
+static struct workqueue_struct * disk_wq = NULL;
+static struct lime_disk_buf disk_bufs[LIME_DISK_BUFS];
+static int cur_buf = 0;
+static atomic_t disk_err = ATOMIC_INIT(0);
+
+static struct file * segs[LIME_MAX_SEGMENTS];
+static struct file * dio_segs[LIME_MAX_SEGMENTS];
+static DEFINE_MUTEX(seg_lock);
+static int seg_count = 0;
+static unsigned long long seg_pos = 0;
+static unsigned long long image_pos = 0;
+static int segs_finished = 0;
+
+static struct file * manifest = NULL;
+static int manifest_err = 0;
 
 static void disable_dio() {
 	DBG("Direct IO may not be supported on this file system. Retrying.");
@@ -58,6 +111,9 @@ static void disable_dio() {
 int setup_disk() {
 	mm_segment_t fs;
 	int err;
+
+	if (segment_size)
+		return setup_segments();
 	
 	fs = get_fs();
 	set_fs(KERNEL_DS);
@@ -84,8 +140,21 @@ int setup_disk() {
 	return 0;
 }
 
+/* Called once the whole image has been handed over, before cleanup. */
+int finish_disk() {
+	if (segment_size)
+		return finish_segments();
+
+	return 0;
+}
+
 void cleanup_disk() {
 	mm_segment_t fs;
+
+	if (segment_size) {
+		cleanup_segments();
+		return;
+	}
 	
 	fs = get_fs();
 	set_fs(KERNEL_DS);
@@ -98,6 +167,9 @@ int write_vaddr_disk(void * v, size_t is) {
 
 	long s;
 
+	if (segment_size)
+		return write_vaddr_segments(v, is);
+
 	fs = get_fs();
 	set_fs(KERNEL_DS);
 	    
@@ -106,9 +178,376 @@ int write_vaddr_disk(void * v, size_t is) {
 	set_fs(fs);
 
 	if (s != is && dio) {
+		trace_lime_dio_fallback(s, is);
 		disable_dio();
 		return write_vaddr_disk(v, is);
 	}
 
 	return s;
 }
+
+static struct file * open_image(const char * name, int flags) {
+	struct file * file = ERR_PTR(-EINVAL);
+	mm_segment_t fs;
+
+	fs = get_fs();
+	set_fs(KERNEL_DS);
+
+	if (dio)
+		file = filp_open(name, O_WRONLY | O_CREAT | O_LARGEFILE | O_SYNC | O_DIRECT | flags, 0444);
+
+	if (file == ERR_PTR(-EINVAL)) {
+		DBG("Direct IO Disabled for %s", name);
+		file = filp_open(name, O_WRONLY | O_CREAT | O_LARGEFILE | flags, 0444);
+	}
+
+	set_fs(fs);
+
+	return file;
+}
+
+static void manifest_printf(const char * fmt, ...) {
+	char line[128];
+	mm_segment_t fs;
+	va_list args;
+	int len;
+	long s;
+
+	if (!manifest)
+		return;
+
+	va_start(args, fmt);
+	len = vscnprintf(line, sizeof(line), fmt, args);
+	va_end(args);
+
+	fs = get_fs();
+	set_fs(KERNEL_DS);
+	s = vfs_write(manifest, line, len, &manifest->f_pos);
+	set_fs(fs);
+
+	if (s != len && !manifest_err)
+		manifest_err = (s < 0) ? (int) s : -EIO;
+}
+
+void note_range_disk(resource_size_t start, resource_size_t end) {
+	manifest_printf("range 0x%llx 0x%llx %llu\n", (unsigned long long) start,
+			(unsigned long long) end, image_pos);
+}
+
+static int open_segment(void) {
+	struct file * file;
+	char * name;
+	int r;
+
+	if (seg_count == LIME_MAX_SEGMENTS)
+		return -EFBIG;
+
+	name = kasprintf(GFP_KERNEL, "%s.%03d", path, seg_count);
+	if (!name)
+		return -ENOMEM;
+
+	file = open_image(name, O_TRUNC);
+	kfree(name);
+
+	if (IS_ERR(file)) {
+		DBG("Error opening segment %d %ld", seg_count, PTR_ERR(file));
+		return PTR_ERR(file);
+	}
+
+	// Not every file system can do this (FAT on older kernels), carry on without
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,19,0)
+	r = vfs_fallocate(file, 0, 0, segment_size);
+#else
+	r = do_fallocate(file, 0, 0, segment_size);
+#endif
+	if (r && r != -EOPNOTSUPP) {
+		DBG("Couldn't preallocate segment %d %d", seg_count, r);
+		filp_close(file, NULL);
+		return r;
+	}
+
+	segs[seg_count++] = file;
+	seg_pos = 0;
+
+	return 0;
+}
+
+/* The file system took the O_DIRECT open but refuses the writes. Reopen
+ * the segment buffered, as write_vaddr_disk() does, and keep later
+ * segments buffered too. Other workers may still hold the direct handle,
+ * so it is only closed with the rest at cleanup. */
+static struct file * reopen_segment(int i) {
+	struct file * file = segs[i];
+	char * name;
+
+	mutex_lock(&seg_lock);
+
+	if (segs[i]->f_flags & O_DIRECT) {
+		dio = 0;
+		name = kasprintf(GFP_KERNEL, "%s.%03d", path, i);
+		file = name ? open_image(name, 0) : ERR_PTR(-ENOMEM);
+		kfree(name);
+
+		if (!IS_ERR(file)) {
+			dio_segs[i] = segs[i];
+			segs[i] = file;
+		}
+	} else
+		file = segs[i];
+
+	mutex_unlock(&seg_lock);
+
+	return file;
+}
+
+static long write_buf(struct file * file, struct lime_disk_buf * b, size_t * len) {
+	int timed = lime_trace_timed(lime_segment_write);
+	ktime_t t = ktime_set(0, 0);
+	mm_segment_t fs;
+	loff_t pos = b->pos;
+	long s;
+
+	*len = b->len;
+
+	// Direct IO needs whole blocks; the tail is truncated away later
+	if (file->f_flags & O_DIRECT) {
+		*len = PAGE_ALIGN(*len);
+		memset(b->data + b->len, 0, *len - b->len);
+	}
+
+	if (timed)
+		t = ktime_get();
+
+	fs = get_fs();
+	set_fs(KERNEL_DS);
+	s = vfs_write(file, b->data, *len, &pos);
+	set_fs(fs);
+
+	if (timed)
+		trace_lime_segment_write(b->seg, b->pos, *len, s, ktime_to_ns(ktime_sub(ktime_get(), t)));
+
+	return s;
+}
+
+static void write_work(struct work_struct * work) {
+	struct lime_disk_buf * b = container_of(work, struct lime_disk_buf, work);
+	struct file * file = segs[b->seg];
+	size_t len;
+	long s;
+
+	s = write_buf(file, b, &len);
+
+	if (s != len && (file->f_flags & O_DIRECT)) {
+		trace_lime_dio_fallback(s, len);
+		file = reopen_segment(b->seg);
+		s = IS_ERR(file) ? PTR_ERR(file) : write_buf(file, b, &len);
+	}
+
+	if (s != len) {
+		DBG("Error writing segment data %ld", s);
+		atomic_cmpxchg(&disk_err, 0, (s < 0) ? (int) s : -EIO);
+	}
+
+	complete(&b->done);
+}
+
+/* Hand the current buffer to the workqueue and wait for the next one in
+ * the ring to come back. */
+static int submit_buf(void) {
+	struct lime_disk_buf * b = &disk_bufs[cur_buf];
+
+	if (b->len) {
+		INIT_WORK(&b->work, write_work);
+		queue_work(disk_wq, &b->work);
+
+		cur_buf = (cur_buf + 1) % LIME_DISK_BUFS;
+		b = &disk_bufs[cur_buf];
+
+		wait_for_completion(&b->done);
+		b->len = 0;
+	}
+
+	return atomic_read(&disk_err);
+}
+
+static int setup_segments(void) {
+	mm_segment_t fs;
+	char * name;
+	int i;
+
+	if (segment_size & ~PAGE_MASK)
+		return -EINVAL;
+
+	atomic_set(&disk_err, 0);
+	segs_finished = 0;
+	manifest_err = 0;
+	seg_count = 0;
+	image_pos = 0;
+	cur_buf = 0;
+
+	disk_wq = alloc_workqueue("lime_disk", WQ_UNBOUND, LIME_DISK_BUFS);
+	if (!disk_wq)
+		return -ENOMEM;
+
+	for (i = 0; i < LIME_DISK_BUFS; i++) {
+		disk_bufs[i].len = 0;
+		disk_bufs[i].data = (char *) __get_free_pages(GFP_KERNEL, LIME_DISK_BUF_ORDER);
+
+		if (!disk_bufs[i].data)
+			return -ENOMEM;
+
+		// Every buffer but the current one starts out free
+		init_completion(&disk_bufs[i].done);
+		if (i)
+			complete(&disk_bufs[i].done);
+	}
+
+	name = kasprintf(GFP_KERNEL, "%s.manifest", path);
+	if (!name)
+		return -ENOMEM;
+
+	fs = get_fs();
+	set_fs(KERNEL_DS);
+	manifest = filp_open(name, O_WRONLY | O_CREAT | O_TRUNC | O_LARGEFILE, 0444);
+	set_fs(fs);
+	kfree(name);
+
+	if (IS_ERR(manifest)) {
+		int err = PTR_ERR(manifest);
+
+		manifest = NULL;
+		return err;
+	}
+
+	manifest_printf("# LiME segment manifest\n");
+	manifest_printf("version 1\n");
+	manifest_printf("segment_size %llu\n", segment_size);
+
+	return 0;
+}
+
+/* Write out the last buffer and wait for every worker, trim the last
+ * segment and complete the manifest. Write errors from the workers only
+ * surface here. */
+static int finish_segments(void) {
+	mm_segment_t fs;
+	int err, r, i;
+
+	segs_finished = 1;
+
+	err = submit_buf();
+	flush_workqueue(disk_wq);
+
+	if (!err)
+		err = atomic_read(&disk_err);
+
+	manifest_printf("size %llu\n", image_pos);
+	manifest_printf("segments %d\n", seg_count);
+
+	fs = get_fs();
+	set_fs(KERNEL_DS);
+
+	for (i = 0; i < seg_count; i++) {
+		unsigned long long len = (i == seg_count - 1) ? seg_pos : segment_size;
+
+		// Give back the preallocated space the image didn't use
+		if (i == seg_count - 1) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,9,0)
+			r = vfs_truncate(&segs[i]->f_path, len);
+#else
+			r = do_truncate(segs[i]->f_path.dentry, len, 0, segs[i]);
+#endif
+			if (r && !err) {
+				DBG("Error truncating segment %d %d", i, r);
+				err = r;
+			}
+		}
+
+		manifest_printf("segment %d %s.%03d %llu %llu\n", i, path, i,
+				(unsigned long long) i * segment_size, len);
+	}
+
+	if (manifest) {
+		r = filp_close(manifest, NULL);
+		manifest = NULL;
+
+		if (r && !manifest_err)
+			manifest_err = r;
+	}
+
+	set_fs(fs);
+
+	return err ? err : manifest_err;
+}
+
+static void cleanup_segments(void) {
+	mm_segment_t fs;
+	int i;
+
+	// Setup failed or the dump stopped early, still leave a usable manifest
+	if (disk_wq && !segs_finished)
+		finish_segments();
+
+	if (disk_wq) {
+		destroy_workqueue(disk_wq);
+		disk_wq = NULL;
+	}
+
+	for (i = 0; i < LIME_DISK_BUFS; i++) {
+		if (disk_bufs[i].data)
+			free_pages((unsigned long) disk_bufs[i].data, LIME_DISK_BUF_ORDER);
+		disk_bufs[i].data = NULL;
+	}
+
+	fs = get_fs();
+	set_fs(KERNEL_DS);
+
+	for (i = 0; i < seg_count; i++) {
+		filp_close(segs[i], NULL);
+
+		if (dio_segs[i])
+			filp_close(dio_segs[i], NULL);
+		dio_segs[i] = NULL;
+	}
+
+	if (manifest)
+		filp_close(manifest, NULL);
+
+	set_fs(fs);
+
+	manifest = NULL;
+	seg_count = 0;
+}
+
+static int write_vaddr_segments(void * v, size_t is) {
+	struct lime_disk_buf * b;
+	size_t done = 0, n;
+	int err;
+
+	while (done < is) {
+		if ((!seg_count || seg_pos == segment_size) && (err = open_segment()))
+			return err;
+
+		b = &disk_bufs[cur_buf];
+
+		if (!b->len) {
+			b->seg = seg_count - 1;
+			b->pos = seg_pos;
+		}
+
+		n = min_t(size_t, is - done, LIME_DISK_BUF_SIZE - b->len);
+		n = min_t(unsigned long long, n, segment_size - seg_pos);
+		memcpy(b->data + b->len, (char *) v + done, n);
+
+		b->len += n;
+		seg_pos += n;
+		image_pos += n;
+		done += n;
+
+		// Buffers never straddle two segments
+		if ((b->len == LIME_DISK_BUF_SIZE || seg_pos == segment_size) && (err = submit_buf()))
+			return err;
+	}
+
+	return is;
+}
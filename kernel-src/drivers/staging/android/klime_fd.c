@@ -0,0 +1,96 @@
+/*
+ * LiME - Linux Memory Extractor
+ * Copyright (c) 2011-2013 Joe Sylve - 504ENSICS Labs
+ *
+ *
+ * Author(s):
+ * Joe Sylve       - joe.sylve@gmail.com, @jtsylve
+ * Jake Valletta   - javallet@gmail.com, @jake_valletta
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/* This fork of LiME allows Android applications and programs
+ * in userspace the ability to arbitrarily dump system memory using a
+ * device driver. All credit for LiME functionality goes to Joe;
+ * I simply created an API around it.
+ *
+ * A NOTE ON SECURITY:
+ * This initial fork of LiME lacks any UAC or security model.  The driver
+ * is accessible to userspace and applications.  Any application or
+ * program can link against the LiME code and potentially dump memory.
+ * This will be addressed in further releases.
+ *
+ * TL;DR - Don't install this on a production ROM (yet)!!!!!
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/uaccess.h>
+
+#include "klime.h"
+
+/* Output to a file the caller already holds open: a regular file, a pipe,
+ * a connected socket or a memfd. The ioctl takes the reference, this only
+ * writes through it. The descriptor should be blocking; a short write is
+ * retried, an error ends the dump. */
+
+int write_vaddr_fd(void *, size_t);
+int setup_fd(void);
+void cleanup_fd(void);
+
+extern struct file * out_file;
+
+int setup_fd() {
+	if (!out_file)
+		return -EBADF;
+
+	if (!(out_file->f_mode & FMODE_WRITE))
+		return -EBADF;
+
+	return 0;
+}
+
+void cleanup_fd() {
+}
+
+int write_vaddr_fd(void * v, size_t is) {
+	mm_segment_t fs;
+
+	ssize_t s = 0;
+	size_t done = 0;
+
+	fs = get_fs();
+	set_fs(KERNEL_DS);
+
+	// Pipes and sockets take what fits
+	while (done < is) {
+		s = vfs_write(out_file, (char *) v + done, is - done, &out_file->f_pos);
+
+		if (s <= 0)
+			break;
+
+		done += s;
+	}
+
+	set_fs(fs);
+
+	// A write that moves nothing would otherwise read as success
+	if (done < is && s == 0)
+		s = -EIO;
+
+	return (done == is) ? is : s;
+}
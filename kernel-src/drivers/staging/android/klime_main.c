@@ -38,22 +38,39 @@
 
 #include <linux/module.h>
 #include <linux/fs.h>
+#include <linux/file.h>
 #include <linux/miscdevice.h>
 #include <linux/uaccess.h>
 #include <linux/poll.h>
 #include <linux/time.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/sort.h>
+#include <linux/ktime.h>
 #include "klime.h"
 
+#define CREATE_TRACE_POINTS
+#include "klime_trace.h"
+
 #include <asm/ioctls.h>
+#include <asm/sections.h>
 
 /* From main.c */
 // This file
-static int write_lime_header(struct resource *);
+static int write_lime_header(resource_size_t, resource_size_t, int);
 static int write_padding(size_t);
-static int write_range(struct resource *);
+static int write_range(resource_size_t, resource_size_t);
+int write_meta(unsigned int, unsigned int, void *, size_t);
+static int write_ram(void);
+static int build_ram_map(lime_range *, int, lime_range *, int);
+static int write_kernel(void);
+int write_class(resource_size_t, resource_size_t, int);
+static int write_segment_meta(void);
 static int write_vaddr(void *, size_t);
+size_t direct_span(resource_size_t, resource_size_t);
+int write_sink(void *, size_t);
+static int write_method(void *, size_t);
 static int setup(void);
 static void cleanup(void);
 static int init(void);
@@ -65,7 +82,43 @@ extern void cleanup_tcp(void);
 
 extern int write_vaddr_disk(void *, size_t);
 extern int setup_disk(void);
+extern int finish_disk(void);
 extern void cleanup_disk(void);
+extern void note_range_disk(resource_size_t, resource_size_t);
+
+extern int write_vaddr_fd(void *, size_t);
+extern int setup_fd(void);
+extern void cleanup_fd(void);
+
+extern int write_proc(void);
+extern int write_ordered(void);
+
+extern int setup_scan(lime_pattern *, int);
+extern void cleanup_scan(void);
+extern void reset_scan(void);
+extern void scan_vaddr(resource_size_t, const void *, size_t);
+extern int flush_scan(void);
+
+extern int setup_stats(void);
+extern void stats_vaddr(resource_size_t, const void *, size_t);
+extern int flush_stats(void);
+
+extern int write_boot(void);
+extern int write_zram(void);
+
+extern int setup_pfn(void);
+extern void pfn_range(resource_size_t, size_t);
+extern int flush_pfn(void);
+
+extern int setup_smear(void);
+extern void cleanup_smear(void);
+extern void smear_vaddr(resource_size_t, const void *, size_t);
+extern int write_smear(void);
+
+extern int setup_crypto(int, unsigned char *);
+extern int finish_crypto(void);
+extern void cleanup_crypto(void);
+extern int write_vaddr_crypto(void *, size_t);
 
 static int mode = 0;
 static int method = 0;
@@ -74,54 +127,311 @@ static char zero_page[PAGE_SIZE];
 char * path = 0;
 int dio = 1;
 int port = 0;
+unsigned long long segment_size = 0;
+int * pids = NULL;
+int pid_count = 0;
+int zram_index = 0;
+struct file * out_file = NULL;
+
+static int triage = LIME_TRIAGE_OFF;
+static int pattern_count = 0;
+static lime_pattern * patterns = NULL;
+static int entropy = 0;
+static int smear = 0;
+static int pfn_meta = 0;
+static int boot = 0;
+static int order = LIME_ORDER_PHYSICAL;
+static int cipher = LIME_CIPHER_NONE;
+static unsigned char * key = NULL;
+static lime_range * windows = NULL;
+static int window_count = 0;
+static int segmented = 0;
 
 extern struct resource iomem_resource;
 
+/* The "System RAM" pieces this dump covers */
+lime_range ram_ranges[2 * LIME_MAX_RANGES];
+int ram_count = 0;
+
 static int init() {
-        struct resource *p;
         int err = 0;
+
+        DBG("Initilizing Dump...");
+
+        ram_count = build_ram_map(windows, window_count, ram_ranges, ARRAY_SIZE(ram_ranges));
+        if (ram_count < 0)
+                return ram_count;
+
+        if (pattern_count && (err = setup_scan(patterns, pattern_count))) {
+                DBG("Error building pattern automaton");
+                return err;
+        }
+
+        if (entropy)
+                setup_stats();
+
+        if (pfn_meta)
+                setup_pfn();
+
+        if (smear && (err = setup_smear())) {
+                DBG("Error allocating chunk hashes");
+                goto out;
+        }
+
+        if((err = setup())) {
+                DBG("Setup Error");
+                cleanup();
+                goto out;
+        }
+
+        if (cipher && (err = setup_crypto(cipher, key))) {
+                DBG("Error setting up encryption");
+                goto done;
+        }
+
+        if (boot && (err = write_boot()))
+                goto done;
+
+        if (zram_index && (err = write_zram()))
+                goto done;
+
+        if (pid_count > 0)
+                err = write_proc();
+        else if (triage == LIME_TRIAGE_OFF)
+                err = write_ram();
+        else if (!(err = write_kernel()) && triage == LIME_TRIAGE_FIRST)
+                err = write_ram();
+
+        if (!err && smear)
+                err = write_smear();
+
+        if (!err && cipher)
+                err = finish_crypto();
+
+        // Segments are written behind the dump, their errors only show up now
+        if (!err && method == LIME_METHOD_DISK)
+                err = finish_disk();
+
+done:
+        if (cipher)
+                cleanup_crypto();
+
+        cleanup();
+
+out:
+        // Normally already wiped once the cipher is keyed
+        if (cipher)
+                memset(key, 0, LIME_KEY_SIZE);
+
+        if (smear)
+                cleanup_smear();
+
+        if (pattern_count)
+                cleanup_scan();
+
+        return err;
+}
+
+static int write_ram() {
+        resource_size_t start, end;
+        int i, err = 0;
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,18)
         resource_size_t p_last = -1;
 #else
         __PTRDIFF_TYPE__ p_last = -1;
 #endif
 
-        DBG("Initilizing Dump...");
+        if (order == LIME_ORDER_VOLATILITY)
+                return write_ordered();
 
-        if((err = setup())) {
-                DBG("Setup Error");
-                cleanup();
-                return err;
+        for (i = 0; i < ram_count; i++) {
+                start = ram_ranges[i].start;
+                end = ram_ranges[i].end;
+
+                if (mode == LIME_MODE_LIME) {
+                        if ((err = write_class(start, end, LIME_RANGE_RAM)))
+                                break;
+
+                        continue;
+                } else if (mode == LIME_MODE_PADDED && (err = write_padding((size_t) ((start - 1) - p_last)))) {
+                        DBG("Error writing padding 0x%lx - 0x%lx", (long) p_last, (long) start - 1);
+                        break;
+                }
+
+                if ((err = write_range(start, end))) {
+                        DBG("Error writing range 0x%lx - 0x%lx", (long) start, (long) end);
+                        break;
+                }
+
+                p_last = end;
         }
 
-       
+        return err;
+}
+
+/* Collect the pieces of "System RAM" that fall inside the windows (all of
+ * it when there are none) into out, in ascending order. The windows must
+ * be sorted and not overlap. Returns the number of pieces. */
+static int build_ram_map(lime_range * win, int win_count, lime_range * out, int size) {
+        struct resource *p;
+        unsigned long long s, e;
+        int i, count = 0;
+
         for (p = iomem_resource.child; p ; p = p->sibling) {
                 if (strncmp(p->name, LIME_RAMSTR, sizeof(LIME_RAMSTR)))
                         continue;
 
-                if (mode == LIME_MODE_LIME && (err = write_lime_header(p))) {
-                        DBG("Error writing header 0x%lx - 0x%lx", (long) p->start, (long) p->end);
-                        break;
-                } else if (mode == LIME_MODE_PADDED && (err = write_padding((size_t) ((p->start - 1) - p_last)))) {
-                        DBG("Error writing padding 0x%lx - 0x%lx", (long) p_last, (long) p->start - 1);
-                        break;
+                for (i = 0; i < (win_count ? win_count : 1); i++) {
+                        s = p->start;
+                        e = p->end;
+
+                        if (win_count) {
+                                s = max_t(unsigned long long, s, win[i].start);
+                                e = min_t(unsigned long long, e, win[i].end);
+                        }
+
+                        if (s > e)
+                                continue;
+
+                        if (count == size)
+                                return -E2BIG;
+
+                        out[count].start = s;
+                        out[count].end = e;
+                        count++;
                 }
+        }
 
-                if ((err = write_range(p))) {
-                        DBG("Error writing range 0x%lx - 0x%lx", (long) p->start, (long) p->end);
-                        break;
+        return count;
+}
+
+static int cmp_range(const void * a, const void * b) {
+        const lime_range * ra = a, * rb = b;
+
+        return (ra->start > rb->start) - (ra->start < rb->start);
+}
+
+/* Page align, sort and merge the requested windows in place. */
+static int clean_windows(lime_range * windows, int count) {
+        int i, n = 0;
+
+        for (i = 0; i < count; i++) {
+                if (windows[i].start > windows[i].end)
+                        return -EINVAL;
+
+                windows[i].start &= ~((unsigned long long) PAGE_SIZE - 1);
+                windows[i].end |= PAGE_SIZE - 1;
+        }
+
+        sort(windows, count, sizeof(lime_range), cmp_range, NULL);
+
+        for (i = 0; i < count; i++) {
+                if (n && windows[i].start <= windows[n - 1].end + 1)
+                        windows[n - 1].end = max_t(unsigned long long, windows[n - 1].end, windows[i].end);
+                else
+                        windows[n++] = windows[i];
+        }
+
+        return n;
+}
+
+/* Triage acquisition: the kernel image followed by every slab page,
+ * each tagged with its class in the range header. */
+static int write_kernel() {
+        struct resource *p;
+        unsigned long pfn, s_pfn = 0, e_pfn;
+        int in_run, err;
+
+        if ((err = write_class(__pa(_text) & PAGE_MASK, PAGE_ALIGN(__pa(_etext)) - 1, LIME_RANGE_KTEXT)))
+                return err;
+
+        // Read only data (and __init) sits between the two on arm, arm64 and x86
+        if (PAGE_ALIGN(__pa(_etext)) < (__pa(_sdata) & PAGE_MASK) &&
+            (err = write_class(PAGE_ALIGN(__pa(_etext)), (__pa(_sdata) & PAGE_MASK) - 1, LIME_RANGE_KRODATA)))
+                return err;
+
+        if ((err = write_class(__pa(_sdata) & PAGE_MASK, PAGE_ALIGN(__pa(_end)) - 1, LIME_RANGE_KDATA)))
+                return err;
+
+        for (p = iomem_resource.child; p ; p = p->sibling) {
+                if (strncmp(p->name, LIME_RAMSTR, sizeof(LIME_RAMSTR)))
+                        continue;
+
+                e_pfn = p->end >> PAGE_SHIFT;
+                in_run = 0;
+
+                for (pfn = p->start >> PAGE_SHIFT; pfn <= e_pfn; pfn++) {
+                        if (pfn_valid(pfn) && PageSlab(compound_head(pfn_to_page(pfn)))) {
+                                if (!in_run) {
+                                        s_pfn = pfn;
+                                        in_run = 1;
+                                }
+                                continue;
+                        }
+
+                        if (in_run && (err = write_class(PFN_PHYS(s_pfn), PFN_PHYS(pfn) - 1, LIME_RANGE_SLAB)))
+                                return err;
+
+                        in_run = 0;
                 }
 
-                p_last = p->end;
+                if (in_run && (err = write_class(PFN_PHYS(s_pfn), PFN_PHYS(e_pfn + 1) - 1, LIME_RANGE_SLAB)))
+                        return err;
         }
-       
 
-        cleanup();
+        return 0;
+}
 
-        return err;
+/* Write a range with its lime header. When per-segment metadata is being
+ * collected the range is split into LIME_SEGMENT_SIZE pieces, each with
+ * its own header, so the metadata can be flushed in between. */
+int write_class(resource_size_t start, resource_size_t end, int class) {
+        resource_size_t s, e;
+        int err;
+
+        if (pattern_count)
+                reset_scan();
+
+        for (s = start; s <= end; s = e + 1) {
+                e = segmented ? min_t(resource_size_t, end, s | (LIME_SEGMENT_SIZE - 1)) : end;
+
+                if ((err = write_lime_header(s, e, class))) {
+                        DBG("Error writing header 0x%lx - 0x%lx", (long) s, (long) e);
+                        return err;
+                }
+
+                if ((err = write_range(s, e))) {
+                        DBG("Error writing range 0x%lx - 0x%lx", (long) s, (long) e);
+                        return err;
+                }
+
+                if ((err = write_segment_meta()))
+                        return err;
+
+                // Don't wrap around at the top of the address space
+                if (e == end)
+                        break;
+        }
+
+        return 0;
 }
 
-static int write_lime_header(struct resource * res) {
+static int write_segment_meta() {
+        int err;
+
+        if (pattern_count && (err = flush_scan()))
+                return err;
+
+        if (entropy && (err = flush_stats()))
+                return err;
+
+        if (pfn_meta && (err = flush_pfn()))
+                return err;
+
+        return 0;
+}
+
+static int write_lime_header(resource_size_t start, resource_size_t end, int class) {
         long s;
 
         lime_mem_range_header header;
@@ -129,8 +439,9 @@ static int write_lime_header(struct resource * res) {
         memset(&header, 0, sizeof(lime_mem_range_header));
         header.magic = LIME_MAGIC;
         header.version = 1;
-        header.s_addr = res->start;
-        header.e_addr = res->end;
+        header.s_addr = start;
+        header.e_addr = end;
+        header.reserved[0] = (unsigned char) class;
        
         s = write_vaddr(&header, sizeof(lime_mem_range_header));
        
@@ -142,6 +453,37 @@ static int write_lime_header(struct resource * res) {
         return 0;
 }
 
+int write_meta(unsigned int type, unsigned int flags, void * v, size_t is) {
+        long s;
+
+        lime_meta_header header;
+
+        // Metadata only has somewhere to live in the lime format
+        if (mode != LIME_MODE_LIME)
+                return 0;
+
+        memset(&header, 0, sizeof(lime_meta_header));
+        header.magic = LIME_META_MAGIC;
+        header.version = 1;
+        header.type = type;
+        header.flags = flags;
+        header.size = is;
+
+        s = write_vaddr(&header, sizeof(lime_meta_header));
+
+        if (s != sizeof(lime_meta_header)) {
+                DBG("Error sending metadata header %ld", s);
+                return (int) s;
+        }
+
+        if (is && (s = write_vaddr(v, is)) != is) {
+                DBG("Error sending metadata %ld", s);
+                return (int) s;
+        }
+
+        return 0;
+}
+
 static int write_padding(size_t s) {
         size_t i = 0;
         int r;
@@ -160,7 +502,7 @@ static int write_padding(size_t s) {
         return 0;
 }
 
-static int write_range(struct resource * res) {
+static int write_range(resource_size_t start, resource_size_t end) {
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,18)
         resource_size_t i, is;
 #else
@@ -171,35 +513,118 @@ static int write_range(struct resource * res) {
        
         int s;
 
-        for (i = res->start; i <= res->end; i += PAGE_SIZE) {
+        // Let the manifest know where this range lands in the image
+        if (method == LIME_METHOD_DISK && segment_size)
+                note_range_disk(start, end);
 
-                p = pfn_to_page((i) >> PAGE_SHIFT);
-       
-        is = min((size_t) PAGE_SIZE, (size_t) (res->end - i + 1));
+        trace_lime_range_start(start, end);
+
+        for (i = start; i <= end; i += is) {
+
+                // Lowmem is read straight from the direct map a span at a time
+                if ((is = direct_span(i, end))) {
+                        p = NULL;
+                        v = __va(i);
+                } else {
+                        p = pfn_to_page((i) >> PAGE_SHIFT);
+                        is = min((size_t) PAGE_SIZE, (size_t) (end - i + 1));
+                        v = kmap(p);
+                }
+
+                trace_lime_batch(i, is, p == NULL);
 
-                v = kmap(p);
+                if (pattern_count)
+                        scan_vaddr(i, v, is);
+                if (entropy)
+                        stats_vaddr(i, v, is);
+                if (smear)
+                        smear_vaddr(i, v, is);
+                if (pfn_meta)
+                        pfn_range(i, is);
                 s = write_vaddr(v, is);
-                kunmap(p);
+
+                if (p)
+                        kunmap(p);
 
                 if (s != is) {
                         DBG("Error sending page %d", s);
+                        trace_lime_range_end(start, end, s);
                         return (int) s;
                 }                              
         }
 
+        trace_lime_range_end(start, end, 0);
+
         return 0;
 }
 
+/* How much of [paddr, end] can be read through the direct map in one
+ * piece, stopping at the next LIME_SPAN_SIZE boundary. Zero for highmem,
+ * which still has to be kmapped a page at a time. */
+size_t direct_span(resource_size_t paddr, resource_size_t end) {
+        resource_size_t lowmem_end = __pa(high_memory - 1);
+
+        if (paddr > lowmem_end)
+                return 0;
+
+        end = min(end, lowmem_end);
+
+        return (size_t) min_t(resource_size_t, end - paddr + 1, LIME_SPAN_SIZE - (paddr & (LIME_SPAN_SIZE - 1)));
+}
+
 static int write_vaddr(void * v, size_t is) {
-        return (method == LIME_METHOD_TCP) ? write_vaddr_tcp(v, is) : write_vaddr_disk(v, is);
+        return cipher ? write_vaddr_crypto(v, is) : write_sink(v, is);
+}
+
+int write_sink(void * v, size_t is) {
+        ktime_t t;
+        int s;
+
+        // Timing costs two clock reads per call, so only pay it while traced
+        if (!lime_trace_timed(lime_sink))
+                return write_method(v, is);
+
+        t = ktime_get();
+        s = write_method(v, is);
+        trace_lime_sink(method, is, s, ktime_to_ns(ktime_sub(ktime_get(), t)));
+
+        return s;
+}
+
+static int write_method(void * v, size_t is) {
+        switch (method) {
+        case LIME_METHOD_TCP:
+                return write_vaddr_tcp(v, is);
+        case LIME_METHOD_FD:
+                return write_vaddr_fd(v, is);
+        default:
+                return write_vaddr_disk(v, is);
+        }
 }
 
 static int setup(void) {
-        return (method == LIME_METHOD_TCP) ? setup_tcp() : setup_disk();
+        switch (method) {
+        case LIME_METHOD_TCP:
+                return setup_tcp();
+        case LIME_METHOD_FD:
+                return setup_fd();
+        default:
+                return setup_disk();
+        }
 }
 
 static void cleanup(void) {
-        return (method == LIME_METHOD_TCP) ? cleanup_tcp() : cleanup_disk();
+        switch (method) {
+        case LIME_METHOD_TCP:
+                cleanup_tcp();
+                break;
+        case LIME_METHOD_FD:
+                cleanup_fd();
+                break;
+        default:
+                cleanup_disk();
+                break;
+        }
 }
 /* End main.c code */
 
@@ -217,6 +642,62 @@ static void set_status(int new_status)
 	lime_status = new_status;
 }
 
+/* Validate the options shared by every dump request. Called after
+ * mode, method and pid_count are set. */
+static int set_opts(lime_dump_opts *opts)
+{
+	if (opts->triage < LIME_TRIAGE_OFF || opts->triage > LIME_TRIAGE_ONLY)
+		return -EINVAL;
+
+	// Range classes live in the lime headers
+	if (opts->triage != LIME_TRIAGE_OFF && (mode != LIME_MODE_LIME || pid_count > 0))
+		return -EINVAL;
+
+	if (opts->pattern_count < 0 || opts->pattern_count > LIME_MAX_PATTERNS)
+		return -EINVAL;
+
+	// Hits, statistics, recaptures and the other indexes are metadata records
+	if ((opts->pattern_count || opts->entropy || opts->smear || opts->pfn_meta || opts->boot || opts->zram) && mode != LIME_MODE_LIME)
+		return -EINVAL;
+
+	// Out of order ranges need their headers; process dumps have their own order
+	if (opts->order != LIME_ORDER_PHYSICAL &&
+	    (opts->order != LIME_ORDER_VOLATILITY || mode != LIME_MODE_LIME || pid_count > 0))
+		return -EINVAL;
+
+	if (opts->cipher < LIME_CIPHER_NONE || opts->cipher > LIME_CIPHER_CHACHA20_POLY1305)
+		return -EINVAL;
+
+	// The segment manifest records plain stream offsets, which sealed frames move
+	if (opts->cipher != LIME_CIPHER_NONE && segment_size)
+		return -EINVAL;
+
+	// Windows restrict the "System RAM" walk; triage and process dumps don't do one
+	if (opts->window_count < 0 || opts->window_count > LIME_MAX_RANGES ||
+	    (opts->window_count && (opts->triage != LIME_TRIAGE_OFF || pid_count > 0)))
+		return -EINVAL;
+
+	if ((window_count = clean_windows(opts->windows, opts->window_count)) < 0)
+		return window_count;
+
+	windows = opts->windows;
+
+	triage = opts->triage;
+	order = opts->order;
+	cipher = opts->cipher;
+	key = opts->key;
+	pattern_count = opts->pattern_count;
+	patterns = opts->patterns;
+	entropy = opts->entropy;
+	smear = opts->smear;
+	pfn_meta = opts->pfn_meta;
+	boot = opts->boot;
+	zram_index = opts->zram;
+	segmented = (pattern_count > 0 || entropy || pfn_meta);
+
+	return 0;
+}
+
 struct device_lime {
         struct miscdevice misc;
 };
@@ -242,26 +723,42 @@ static long lime_ioctl(struct file *file, unsigned int cmd, unsigned long ioctl_
 
                         set_status(LIME_STATUS_BUSY);
 
-			temp = (lime_dump_disk *)ioctl_param;
-			if (copy_from_user((char *)temp, (char *)ioctl_param, sizeof(*temp)) != 0)
+			temp = kmalloc(sizeof(*temp), GFP_KERNEL);
+			if (!temp)
 			{
-				DBG("Couldn't copy lime_dump_disk struct to kernel space!");
-				ret_val = -1;
+				ret_val = -ENOMEM;
 				set_status(LIME_STATUS_READY);
 				goto out;
 			}
 
+			if (copy_from_user(temp, (void __user *)ioctl_param, sizeof(*temp)) != 0)
+			{
+				DBG("Couldn't copy lime_dump_disk struct to kernel space!");
+				ret_val = -EFAULT;
+				goto disk_out;
+			}
+
+			temp->file_name[LIME_MAX_FILENAME_SIZE - 1] = '\0';
+
 			DBG("Starting memory dump to file: %s", temp->file_name);
 
 			mode = temp->mode;
 			dio = temp->dio;
 			method = LIME_METHOD_DISK;
 			path = temp->file_name;
+			segment_size = temp->segment_size;
+			pid_count = 0;
+
+			if ((ret_val = set_opts(&temp->opts)))
+				goto disk_out;
 
 			memset(zero_page, 0, sizeof(zero_page));
 
 			// Call memory dump code
 			ret_val = init();
+disk_out:
+			// The request carries the stream key, wipe it with the rest
+			kzfree(temp);
 			set_status(LIME_STATUS_READY);
 			break;
 		}
@@ -280,13 +777,19 @@ static long lime_ioctl(struct file *file, unsigned int cmd, unsigned long ioctl_
 			
 			set_status(LIME_STATUS_BUSY);
 
-                        temp = (lime_dump_tcp *)ioctl_param;
-                        if (copy_from_user((char *)temp, (char *)ioctl_param, sizeof(*temp)) != 0)
+			temp = kmalloc(sizeof(*temp), GFP_KERNEL);
+			if (!temp)
+			{
+				ret_val = -ENOMEM;
+				set_status(LIME_STATUS_READY);
+				goto out;
+			}
+
+                        if (copy_from_user(temp, (void __user *)ioctl_param, sizeof(*temp)) != 0)
                         {
                                 DBG("Couldn't copy lime_dump_tcp struct to kernel space!");
-                                ret_val = -1;
-				set_status(LIME_STATUS_READY);
-                                goto out;
+                                ret_val = -EFAULT;
+                                goto tcp_out;
                         }
 
                         DBG("Starting memory dump to port: %d", temp->port);
@@ -295,6 +798,11 @@ static long lime_ioctl(struct file *file, unsigned int cmd, unsigned long ioctl_
                         dio = temp->dio;
                         method = LIME_METHOD_TCP;
                         port = temp->port;
+                        segment_size = 0;
+                        pid_count = 0;
+
+			if ((ret_val = set_opts(&temp->opts)))
+				goto tcp_out;
 
                         memset(zero_page, 0, sizeof(zero_page));
 
@@ -302,10 +810,177 @@ static long lime_ioctl(struct file *file, unsigned int cmd, unsigned long ioctl_
                         ret_val = init();
 
 			DBG("Done!");
+tcp_out:
+			kzfree(temp);
 			set_status(LIME_STATUS_READY);
                         break;
 		}
 		
+		/* ioctl to dump memory to a file descriptor the caller has open. */
+		case LIME_DUMP_FD:
+		{
+			lime_dump_fd *temp;
+
+			if (get_status() == LIME_STATUS_BUSY)
+			{
+				DBG("Device is busy!");
+				ret_val = -EBUSY;
+				goto out;
+			}
+
+			set_status(LIME_STATUS_BUSY);
+
+			temp = kmalloc(sizeof(*temp), GFP_KERNEL);
+			if (!temp)
+			{
+				ret_val = -ENOMEM;
+				set_status(LIME_STATUS_READY);
+				goto out;
+			}
+
+			if (copy_from_user(temp, (void __user *)ioctl_param, sizeof(*temp)) != 0)
+			{
+				DBG("Couldn't copy lime_dump_fd struct to kernel space!");
+				ret_val = -EFAULT;
+				goto fd_out;
+			}
+
+			// Holds the file for the whole dump, whatever the caller does with the fd
+			out_file = fget(temp->fd);
+			if (!out_file)
+			{
+				ret_val = -EBADF;
+				goto fd_out;
+			}
+
+			DBG("Starting memory dump to fd: %d", temp->fd);
+
+			mode = temp->mode;
+			dio = 0;
+			method = LIME_METHOD_FD;
+			segment_size = 0;
+			pid_count = 0;
+
+			if ((ret_val = set_opts(&temp->opts)))
+				goto fd_out;
+
+			memset(zero_page, 0, sizeof(zero_page));
+
+			// Call memory dump code
+			ret_val = init();
+fd_out:
+			if (out_file)
+				fput(out_file);
+
+			out_file = NULL;
+			kzfree(temp);
+			set_status(LIME_STATUS_READY);
+			break;
+		}
+
+		/* ioctl to dump the pages mapped by a set of processes. */
+		case LIME_DUMP_PROC:
+		{
+			lime_dump_proc *temp;
+
+			if (get_status() == LIME_STATUS_BUSY)
+			{
+				DBG("Device is busy!");
+				ret_val = -EBUSY;
+				goto out;
+			}
+
+			set_status(LIME_STATUS_BUSY);
+
+			temp = kmalloc(sizeof(*temp), GFP_KERNEL);
+			if (!temp)
+			{
+				ret_val = -ENOMEM;
+				set_status(LIME_STATUS_READY);
+				goto out;
+			}
+
+			if (copy_from_user(temp, (void __user *)ioctl_param, sizeof(*temp)) != 0)
+			{
+				DBG("Couldn't copy lime_dump_proc struct to kernel space!");
+				ret_val = -EFAULT;
+				goto proc_out;
+			}
+
+			// Pages are only meaningful with their addresses attached
+			if (temp->mode != LIME_MODE_LIME || temp->pid_count <= 0 ||
+			    temp->pid_count > LIME_MAX_PIDS ||
+			    (temp->method != LIME_METHOD_DISK && temp->method != LIME_METHOD_TCP))
+			{
+				DBG("Invalid lime_dump_proc request!");
+				ret_val = -EINVAL;
+				goto proc_out;
+			}
+
+			temp->file_name[LIME_MAX_FILENAME_SIZE - 1] = '\0';
+
+			DBG("Starting dump of %d processes", temp->pid_count);
+
+			mode = temp->mode;
+			dio = temp->dio;
+			method = temp->method;
+			path = temp->file_name;
+			port = temp->port;
+			segment_size = 0;
+			pids = temp->pids;
+			pid_count = temp->pid_count;
+
+			if ((ret_val = set_opts(&temp->opts)))
+				goto proc_out;
+
+			memset(zero_page, 0, sizeof(zero_page));
+
+			// Call memory dump code
+			ret_val = init();
+proc_out:
+			pids = NULL;
+			pid_count = 0;
+			kzfree(temp);
+			set_status(LIME_STATUS_READY);
+			break;
+		}
+
+		/* ioctl to describe the "System RAM" a dump would cover. */
+		case LIME_GET_RAM_MAP:
+		{
+			lime_ram_map *temp;
+			int i;
+
+			temp = kzalloc(sizeof(*temp), GFP_KERNEL);
+			if (!temp)
+			{
+				ret_val = -ENOMEM;
+				goto out;
+			}
+
+			temp->count = build_ram_map(NULL, 0, temp->ranges, LIME_MAX_RANGES);
+			if (temp->count < 0)
+			{
+				ret_val = temp->count;
+				kfree(temp);
+				goto out;
+			}
+
+			for (i = 0; i < temp->count; i++)
+			{
+				temp->size_raw += temp->ranges[i].end - temp->ranges[i].start + 1;
+				temp->size_padded = temp->ranges[i].end + 1;
+			}
+
+			temp->size_lime = temp->size_raw + temp->count * sizeof(lime_mem_range_header);
+
+			if (copy_to_user((void __user *)ioctl_param, temp, sizeof(*temp)) != 0)
+				ret_val = -EFAULT;
+
+			kfree(temp);
+			break;
+		}
+
 		/* ioctl to determine if the device is ready. */
 		case LIME_GET_STATUS:
 		{
@@ -0,0 +1,165 @@
+/*
+ * LiME - Linux Memory Extractor
+ * Copyright (c) 2011-2013 Joe Sylve - 504ENSICS Labs
+ *
+ *
+ * Author(s):
+ * Joe Sylve       - joe.sylve@gmail.com, @jtsylve
+ * Jake Valletta   - javallet@gmail.com, @jake_valletta
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/* This fork of LiME allows Android applications and programs
+ * in userspace the ability to arbitrarily dump system memory using a
+ * device driver. All credit for LiME functionality goes to Joe;
+ * I simply created an API around it.
+ *
+ * A NOTE ON SECURITY:
+ * This initial fork of LiME lacks any UAC or security model.  The driver
+ * is accessible to userspace and applications.  Any application or
+ * program can link against the LiME code and potentially dump memory.
+ * This will be addressed in further releases.
+ *
+ * TL;DR - Don't install this on a production ROM (yet)!!!!!
+ */
+
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/string.h>
+
+#include "klime.h"
+
+/* Page frame metadata. For every pfn that is written, the state of its
+ * struct page at copy time (flags, mapcount, order and a page class) is
+ * collected and written as a LIME_META_PFN record after each segment.
+ * The record is laid out column by column, which keeps runs of like
+ * values together for compressors, and is indexed by pfn. */
+
+int setup_pfn(void);
+void pfn_range(resource_size_t, size_t);
+int flush_pfn(void);
+
+extern int write_meta(unsigned int, unsigned int, void *, size_t);
+
+#define LIME_PFN_BUF	(LIME_SEGMENT_SIZE / PAGE_SIZE + 1)
+#define LIME_PFN_ENTRY	(sizeof(u32) + sizeof(s32) + 2 * sizeof(u8))
+
+static u32 pfn_flags[LIME_PFN_BUF];
+static s32 pfn_mapcount[LIME_PFN_BUF];
+static u8 pfn_order[LIME_PFN_BUF];
+static u8 pfn_class[LIME_PFN_BUF];
+static char pfn_out[sizeof(lime_pfn_header) + LIME_PFN_BUF * LIME_PFN_ENTRY];
+
+static unsigned long first_pfn = 0;
+static unsigned int pfn_used = 0;
+static int pfn_truncated = 0;
+
+static void describe_page(unsigned int i, unsigned long pfn) {
+	struct page * page, * head;
+
+	pfn_flags[i] = 0;
+	pfn_mapcount[i] = 0;
+	pfn_order[i] = 0;
+	pfn_class[i] = LIME_PFN_OTHER;
+
+	if (!pfn_valid(pfn))
+		return;
+
+	page = pfn_to_page(pfn);
+	head = compound_head(page);
+	pfn_flags[i] = (u32) page->flags;
+
+	// Only the first page of a free block is marked, and carries its order
+	if (PageBuddy(page)) {
+		pfn_order[i] = (u8) page_private(page);
+		pfn_class[i] = LIME_PFN_FREE;
+		return;
+	}
+
+	if (PageHead(page))
+		pfn_order[i] = (u8) compound_order(page);
+
+	// Slab keeps its object counters where _mapcount would be
+	if (PageSlab(head)) {
+		pfn_class[i] = LIME_PFN_SLAB;
+		return;
+	}
+
+	pfn_mapcount[i] = page_mapcount(page);
+
+	if (PageReserved(page))
+		pfn_class[i] = LIME_PFN_KERNEL;
+	else if (PageAnon(head))
+		pfn_class[i] = LIME_PFN_ANON;
+	else if (head->mapping)
+		pfn_class[i] = LIME_PFN_FILE;
+}
+
+int setup_pfn() {
+	pfn_used = 0;
+	pfn_truncated = 0;
+
+	return 0;
+}
+
+void pfn_range(resource_size_t paddr, size_t is) {
+	unsigned long pfn = paddr >> PAGE_SHIFT, last = (paddr + is - 1) >> PAGE_SHIFT;
+
+	if (!pfn_used)
+		first_pfn = pfn;
+
+	// A page split across two calls is only described once
+	if (pfn < first_pfn + pfn_used)
+		pfn = first_pfn + pfn_used;
+
+	for (; pfn <= last; pfn++) {
+		// Segments are contiguous and bounded, so this is only a safety net
+		if (pfn != first_pfn + pfn_used || pfn_used == LIME_PFN_BUF) {
+			pfn_truncated = 1;
+			return;
+		}
+
+		describe_page(pfn_used++, pfn);
+	}
+}
+
+int flush_pfn() {
+	lime_pfn_header * header = (lime_pfn_header *) pfn_out;
+	char * c = pfn_out + sizeof(lime_pfn_header);
+	int err;
+
+	if (!pfn_used)
+		return 0;
+
+	header->pfn = first_pfn;
+	header->count = pfn_used;
+	header->page_shift = PAGE_SHIFT;
+
+	memcpy(c, pfn_flags, pfn_used * sizeof(u32));
+	c += pfn_used * sizeof(u32);
+	memcpy(c, pfn_mapcount, pfn_used * sizeof(s32));
+	c += pfn_used * sizeof(s32);
+	memcpy(c, pfn_order, pfn_used);
+	c += pfn_used;
+	memcpy(c, pfn_class, pfn_used);
+	c += pfn_used;
+
+	err = write_meta(LIME_META_PFN, pfn_truncated ? LIME_META_TRUNCATED : 0, pfn_out, c - pfn_out);
+	pfn_used = 0;
+	pfn_truncated = 0;
+
+	return err;
+}
@@ -0,0 +1,373 @@
+/*
+ * LiME - Linux Memory Extractor
+ * Copyright (c) 2011-2013 Joe Sylve - 504ENSICS Labs
+ *
+ *
+ * Author(s):
+ * Joe Sylve       - joe.sylve@gmail.com, @jtsylve
+ * Jake Valletta   - javallet@gmail.com, @jake_valletta
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/* This fork of LiME allows Android applications and programs
+ * in userspace the ability to arbitrarily dump system memory using a
+ * device driver. All credit for LiME functionality goes to Joe;
+ * I simply created an API around it.
+ *
+ * A NOTE ON SECURITY:
+ * This initial fork of LiME lacks any UAC or security model.  The driver
+ * is accessible to userspace and applications.  Any application or
+ * program can link against the LiME code and potentially dump memory.
+ * This will be addressed in further releases.
+ *
+ * TL;DR - Don't install this on a production ROM (yet)!!!!!
+ */
+#include <linux/sched.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/bitops.h>
+#include <linux/rcupdate.h>
+#include <linux/swapops.h>
+
+#include <asm/pgtable.h>
+
+#include "klime.h"
+
+/* Process-scoped acquisition. Rather than walking all of "System RAM",
+ * walk the page tables of the requested tasks, record every physical
+ * page they map in a bitmap (which deduplicates shared pages and sorts
+ * them for free), and then dump the bitmap as runs of LiME ranges.  The
+ * VMAs and virtual to physical mappings are emitted as metadata records
+ * ahead of the ranges so the address spaces can be rebuilt. */
+
+int write_proc(void);
+
+extern int write_class(resource_size_t, resource_size_t, int);
+extern int write_meta(unsigned int, unsigned int, void *, size_t);
+
+extern int * pids;
+extern int pid_count;
+extern int zram_index;
+
+extern struct resource iomem_resource;
+
+#define LIME_VMA_BUF	64
+#define LIME_PTE_BUF	(2 * PTRS_PER_PTE)
+
+static unsigned long * pfn_map = NULL;
+static unsigned long pfn_base = 0;
+static unsigned long pfn_count = 0;
+
+static lime_vma_entry * vma_buf = NULL;
+static int vma_used = 0;
+
+static lime_pte_entry * pte_buf = NULL;
+static int pte_used = 0;
+static unsigned int pte_flags = 0;
+
+static int flush_vmas(void) {
+	int err;
+
+	if (!vma_used)
+		return 0;
+
+	err = write_meta(LIME_META_VMA, 0, vma_buf, vma_used * sizeof(lime_vma_entry));
+	vma_used = 0;
+
+	return err;
+}
+
+static int flush_ptes(void) {
+	int err;
+
+	if (!pte_used)
+		return 0;
+
+	err = write_meta(LIME_META_PTE, pte_flags, pte_buf, pte_used * sizeof(lime_pte_entry));
+	pte_used = 0;
+	pte_flags = 0;
+
+	return err;
+}
+
+/* Size the pfn bitmap from the "System RAM" resources, since max_pfn
+ * is not absolute on every architecture. */
+static int setup_pfn_map(void) {
+	struct resource *p;
+	unsigned long lo = ~0UL, hi = 0;
+
+	for (p = iomem_resource.child; p ; p = p->sibling) {
+		if (strncmp(p->name, LIME_RAMSTR, sizeof(LIME_RAMSTR)))
+			continue;
+
+		lo = min(lo, (unsigned long) (p->start >> PAGE_SHIFT));
+		hi = max(hi, (unsigned long) (p->end >> PAGE_SHIFT) + 1);
+	}
+
+	if (hi <= lo)
+		return -ENODEV;
+
+	pfn_base = lo;
+	pfn_count = hi - lo;
+
+	pfn_map = vmalloc(BITS_TO_LONGS(pfn_count) * sizeof(unsigned long));
+	if (!pfn_map)
+		return -ENOMEM;
+
+	memset(pfn_map, 0, BITS_TO_LONGS(pfn_count) * sizeof(unsigned long));
+
+	return 0;
+}
+
+static void record_page(int pid, unsigned long addr, unsigned long pfn) {
+	if (pfn < pfn_base || pfn - pfn_base >= pfn_count || !pfn_valid(pfn))
+		return;
+
+	__set_bit(pfn - pfn_base, pfn_map);
+
+	pte_buf[pte_used].pid = pid;
+	pte_buf[pte_used].flags = 0;
+	pte_buf[pte_used].vaddr = addr;
+	pte_buf[pte_used].paddr = (unsigned long long) pfn << PAGE_SHIFT;
+	pte_used++;
+}
+
+/* Called with the pte mapped and locked, so this must not sleep. */
+static void walk_pte_range(int pid, pmd_t *pmd, unsigned long addr, unsigned long end, struct mm_struct *mm) {
+	pte_t *start, *pte;
+	spinlock_t *ptl;
+	swp_entry_t entry;
+
+	start = pte = pte_offset_map_lock(mm, pmd, addr, &ptl);
+
+	for (; addr < end; addr += PAGE_SIZE, pte++) {
+		// Swapped out pages point into the zram index
+		if (zram_index && is_swap_pte(*pte)) {
+			entry = pte_to_swp_entry(*pte);
+			if (non_swap_entry(entry))
+				continue;
+
+			pte_buf[pte_used].pid = pid;
+			pte_buf[pte_used].flags = LIME_PTE_SWAP | (swp_type(entry) << 8);
+			pte_buf[pte_used].vaddr = addr;
+			pte_buf[pte_used].paddr = swp_offset(entry);
+			pte_used++;
+			continue;
+		}
+
+		if (pte_present(*pte))
+			record_page(pid, addr, pte_pfn(*pte));
+	}
+
+	pte_unmap_unlock(start, ptl);
+}
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+/* A transparent huge page maps the whole pmd run from one entry. Only
+ * the pfns are recorded, so a racing split changes nothing. */
+static void walk_huge_pmd(int pid, pmd_t pmd, unsigned long addr, unsigned long end) {
+	unsigned long pfn = pmd_pfn(pmd) + ((addr & ~HPAGE_PMD_MASK) >> PAGE_SHIFT);
+
+	for (; addr < end; addr += PAGE_SIZE, pfn++)
+		record_page(pid, addr, pfn);
+}
+#endif
+
+/* Returns where the walk stopped: vm_end, or earlier if the pte buffer
+ * filled up and has to be written out first. */
+static unsigned long walk_vma(int pid, struct vm_area_struct *vma, unsigned long addr) {
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned long next;
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd, pmdval;
+
+	for (; addr < vma->vm_end; addr = next) {
+		next = pmd_addr_end(addr, vma->vm_end);
+
+		pgd = pgd_offset(mm, addr);
+		if (pgd_none(*pgd) || pgd_bad(*pgd)) {
+			next = pgd_addr_end(addr, vma->vm_end);
+			continue;
+		}
+
+		pud = pud_offset(pgd, addr);
+		if (pud_none(*pud) || pud_bad(*pud)) {
+			next = pud_addr_end(addr, vma->vm_end);
+			continue;
+		}
+
+		pmd = pmd_offset(pud, addr);
+		pmdval = *pmd;
+		if (pmd_none(pmdval))
+			continue;
+
+		// Make sure a whole pte table always fits
+		if (LIME_PTE_BUF - pte_used < PTRS_PER_PTE)
+			return addr;
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+		if (pmd_trans_huge(pmdval) && pmd_present(pmdval)) {
+			walk_huge_pmd(pid, pmdval, addr, next);
+			continue;
+		}
+#endif
+
+		// Other huge pmds (hugetlbfs) aren't walked, say so
+		if (pmd_bad(pmdval)) {
+			pte_flags |= LIME_META_TRUNCATED;
+			continue;
+		}
+
+		walk_pte_range(pid, pmd, addr, next, mm);
+	}
+
+	return addr;
+}
+
+/* Sink writes can sleep for a long time (a TCP peer, a slow card), so
+ * mmap_sem is dropped around them. The mappings may change meanwhile,
+ * so the walk picks up again from a fresh find_vma(). */
+static int flush_unlocked(struct mm_struct *mm) {
+	int err;
+
+	up_read(&mm->mmap_sem);
+
+	if (!(err = flush_vmas()))
+		err = flush_ptes();
+
+	down_read(&mm->mmap_sem);
+
+	return err;
+}
+
+static int walk_task(int pid) {
+	struct task_struct *task;
+	struct mm_struct *mm;
+	struct vm_area_struct *vma;
+	unsigned long addr = 0, last_start = 0, last_end = 0;
+	int err = 0;
+
+	rcu_read_lock();
+	task = pid_task(find_vpid(pid), PIDTYPE_PID);
+	if (task)
+		get_task_struct(task);
+	rcu_read_unlock();
+
+	if (!task) {
+		DBG("No such process %d", pid);
+		return -ESRCH;
+	}
+
+	mm = get_task_mm(task);
+	put_task_struct(task);
+
+	// Kernel threads have nothing to give
+	if (!mm)
+		return 0;
+
+	down_read(&mm->mmap_sem);
+
+	while ((vma = find_vma(mm, addr))) {
+		addr = max(addr, vma->vm_start);
+
+		// A new mapping, or one that changed while the lock was dropped
+		if (vma->vm_start != last_start || vma->vm_end != last_end) {
+			if (vma_used == LIME_VMA_BUF) {
+				if ((err = flush_unlocked(mm)))
+					break;
+				continue;
+			}
+
+			vma_buf[vma_used].pid = pid;
+			vma_buf[vma_used].flags = (unsigned int) vma->vm_flags;
+			vma_buf[vma_used].start = vma->vm_start;
+			vma_buf[vma_used].end = vma->vm_end;
+			vma_buf[vma_used].pgoff = vma->vm_pgoff;
+			vma_used++;
+
+			last_start = vma->vm_start;
+			last_end = vma->vm_end;
+		}
+
+		addr = walk_vma(pid, vma, addr);
+
+		if (addr < vma->vm_end && (err = flush_unlocked(mm)))
+			break;
+	}
+
+	up_read(&mm->mmap_sem);
+	mmput(mm);
+
+	return err;
+}
+
+static int write_pfn_map(void) {
+	unsigned long s, e = 0;
+	resource_size_t start, end;
+	int err;
+
+	while ((s = find_next_bit(pfn_map, pfn_count, e)) < pfn_count) {
+		e = find_next_zero_bit(pfn_map, pfn_count, s);
+
+		start = (resource_size_t) (pfn_base + s) << PAGE_SHIFT;
+		end = ((resource_size_t) (pfn_base + e) << PAGE_SHIFT) - 1;
+
+		if ((err = write_class(start, end, LIME_RANGE_RAM)))
+			return err;
+	}
+
+	return 0;
+}
+
+int write_proc() {
+	int i, err;
+
+	vma_buf = kmalloc(LIME_VMA_BUF * sizeof(lime_vma_entry), GFP_KERNEL);
+	pte_buf = kmalloc(LIME_PTE_BUF * sizeof(lime_pte_entry), GFP_KERNEL);
+
+	if (!vma_buf || !pte_buf) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	if ((err = setup_pfn_map()))
+		goto out;
+
+	for (i = 0; i < pid_count; i++) {
+		if ((err = walk_task(pids[i])))
+			goto out;
+	}
+
+	if ((err = flush_vmas()) || (err = flush_ptes()))
+		goto out;
+
+	err = write_pfn_map();
+
+out:
+	vfree(pfn_map);
+	kfree(pte_buf);
+	kfree(vma_buf);
+
+	pfn_map = NULL;
+	pte_buf = NULL;
+	vma_buf = NULL;
+	vma_used = pte_used = 0;
+	pte_flags = 0;
+
+	return err;
+}
@@ -0,0 +1,254 @@
+/*
+ * LiME - Linux Memory Extractor
+ * Copyright (c) 2011-2013 Joe Sylve - 504ENSICS Labs
+ *
+ *
+ * Author(s):
+ * Joe Sylve       - joe.sylve@gmail.com, @jtsylve
+ * Jake Valletta   - javallet@gmail.com, @jake_valletta
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/* This fork of LiME allows Android applications and programs
+ * in userspace the ability to arbitrarily dump system memory using a
+ * device driver. All credit for LiME functionality goes to Joe;
+ * I simply created an API around it.
+ *
+ * A NOTE ON SECURITY:
+ * This initial fork of LiME lacks any UAC or security model.  The driver
+ * is accessible to userspace and applications.  Any application or
+ * program can link against the LiME code and potentially dump memory.
+ * This will be addressed in further releases.
+ *
+ * TL;DR - Don't install this on a production ROM (yet)!!!!!
+ */
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/string.h>
+
+#include "klime.h"
+
+/* In-stream pattern search. The patterns are compiled into an Aho-Corasick
+ * automaton with the failure links folded into a full transition table,
+ * so scanning is a single table lookup per byte and matches which straddle
+ * page boundaries are found as long as the pages are physically contiguous.
+ *
+ * While the automaton sits in its root state, bytes that can't start any
+ * pattern are skipped, whole words at a time for runs of zeros. Hits are
+ * collected per segment and written as LIME_META_HITS records. */
+
+int setup_scan(lime_pattern *, int);
+void cleanup_scan(void);
+void reset_scan(void);
+void scan_vaddr(resource_size_t, const void *, size_t);
+int flush_scan(void);
+
+extern int write_meta(unsigned int, unsigned int, void *, size_t);
+
+#define LIME_MAX_STATES	(LIME_MAX_PATTERNS * LIME_MAX_PATTERN_LEN + 1)
+#define LIME_MAX_HITS	4096
+
+static unsigned short (*scan_next)[256] = NULL;
+static unsigned int * scan_out = NULL;
+static unsigned char scan_starts[256];
+static int scan_skip_zero = 0;
+static unsigned int scan_len[LIME_MAX_PATTERNS];
+static unsigned int scan_state = 0;
+
+static lime_hit_entry * hit_buf = NULL;
+static int hit_used = 0;
+static unsigned int hit_flags = 0;
+
+static int build_automaton(lime_pattern *patterns, int count) {
+	unsigned short *fail, *queue;
+	unsigned int states = 1, head = 0, tail = 0;
+	unsigned int r, u, st;
+	int i, j, c;
+
+	fail = kmalloc(LIME_MAX_STATES * sizeof(unsigned short), GFP_KERNEL);
+	queue = kmalloc(LIME_MAX_STATES * sizeof(unsigned short), GFP_KERNEL);
+
+	if (!fail || !queue) {
+		kfree(fail);
+		kfree(queue);
+		return -ENOMEM;
+	}
+
+	// Trie. No edge ever points back at the root, so 0 means "no edge".
+	for (i = 0; i < count; i++) {
+		for (st = 0, j = 0; j < patterns[i].len; j++) {
+			c = patterns[i].data[j];
+
+			if (!scan_next[st][c])
+				scan_next[st][c] = states++;
+
+			st = scan_next[st][c];
+		}
+
+		scan_out[st] |= 1U << i;
+		scan_len[i] = patterns[i].len;
+	}
+
+	// Breadth first, so a state's failure target is complete before it
+	for (c = 0; c < 256; c++) {
+		if ((u = scan_next[0][c])) {
+			fail[u] = 0;
+			queue[tail++] = u;
+		}
+	}
+
+	while (head < tail) {
+		r = queue[head++];
+
+		for (c = 0; c < 256; c++) {
+			if ((u = scan_next[r][c])) {
+				fail[u] = scan_next[fail[r]][c];
+				scan_out[u] |= scan_out[fail[u]];
+				queue[tail++] = u;
+			} else {
+				scan_next[r][c] = scan_next[fail[r]][c];
+			}
+		}
+	}
+
+	for (c = 0; c < 256; c++)
+		scan_starts[c] = (scan_next[0][c] != 0);
+
+	scan_skip_zero = !scan_starts[0];
+
+	kfree(queue);
+	kfree(fail);
+
+	return 0;
+}
+
+int setup_scan(lime_pattern *patterns, int count) {
+	int i, err;
+
+	for (i = 0; i < count; i++) {
+		if (patterns[i].len == 0 || patterns[i].len > LIME_MAX_PATTERN_LEN)
+			return -EINVAL;
+	}
+
+	scan_next = vmalloc(LIME_MAX_STATES * sizeof(*scan_next));
+	scan_out = kmalloc(LIME_MAX_STATES * sizeof(unsigned int), GFP_KERNEL);
+	hit_buf = vmalloc(LIME_MAX_HITS * sizeof(lime_hit_entry));
+
+	if (!scan_next || !scan_out || !hit_buf) {
+		err = -ENOMEM;
+		goto err;
+	}
+
+	memset(scan_next, 0, LIME_MAX_STATES * sizeof(*scan_next));
+	memset(scan_out, 0, LIME_MAX_STATES * sizeof(unsigned int));
+
+	if ((err = build_automaton(patterns, count)))
+		goto err;
+
+	scan_state = 0;
+	hit_used = 0;
+	hit_flags = 0;
+
+	return 0;
+
+err:
+	cleanup_scan();
+	return err;
+}
+
+void cleanup_scan() {
+	vfree(hit_buf);
+	kfree(scan_out);
+	vfree(scan_next);
+
+	hit_buf = NULL;
+	scan_out = NULL;
+	scan_next = NULL;
+}
+
+/* Matches can't continue across a discontiguous range. */
+void reset_scan() {
+	scan_state = 0;
+}
+
+static void record_hits(resource_size_t addr, unsigned int out) {
+	int i;
+
+	for (i = 0; out; i++, out >>= 1) {
+		if (!(out & 1))
+			continue;
+
+		if (hit_used == LIME_MAX_HITS) {
+			hit_flags |= LIME_META_TRUNCATED;
+			return;
+		}
+
+		hit_buf[hit_used].paddr = addr - scan_len[i] + 1;
+		hit_buf[hit_used].pattern = i;
+		hit_buf[hit_used].reserved = 0;
+		hit_used++;
+	}
+}
+
+void scan_vaddr(resource_size_t paddr, const void *v, size_t is) {
+	const unsigned char *b = v;
+	unsigned int state = scan_state;
+	size_t i = 0;
+
+	while (i < is) {
+		if (!state) {
+			// Prefilter: nothing can match until a start byte shows up
+			while (i < is) {
+				if (scan_skip_zero && !(((unsigned long) (b + i)) & (sizeof(long) - 1)) &&
+				    i + sizeof(long) <= is && !*(const unsigned long *) (b + i)) {
+					i += sizeof(long);
+					continue;
+				}
+
+				if (scan_starts[b[i]])
+					break;
+
+				i++;
+			}
+
+			if (i == is)
+				break;
+		}
+
+		state = scan_next[state][b[i]];
+
+		if (unlikely(scan_out[state]))
+			record_hits(paddr + i, scan_out[state]);
+
+		i++;
+	}
+
+	scan_state = state;
+}
+
+int flush_scan() {
+	int err;
+
+	if (!hit_used && !hit_flags)
+		return 0;
+
+	err = write_meta(LIME_META_HITS, hit_flags, hit_buf, hit_used * sizeof(lime_hit_entry));
+	hit_used = 0;
+	hit_flags = 0;
+
+	return err;
+}
@@ -0,0 +1,177 @@
+/*
+ * LiME - Linux Memory Extractor
+ * Copyright (c) 2011-2013 Joe Sylve - 504ENSICS Labs
+ *
+ *
+ * Author(s):
+ * Joe Sylve       - joe.sylve@gmail.com, @jtsylve
+ * Jake Valletta   - javallet@gmail.com, @jake_valletta
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/* This fork of LiME allows Android applications and programs
+ * in userspace the ability to arbitrarily dump system memory using a
+ * device driver. All credit for LiME functionality goes to Joe;
+ * I simply created an API around it.
+ *
+ * A NOTE ON SECURITY:
+ * This initial fork of LiME lacks any UAC or security model.  The driver
+ * is accessible to userspace and applications.  Any application or
+ * program can link against the LiME code and potentially dump memory.
+ * This will be addressed in further releases.
+ *
+ * TL;DR - Don't install this on a production ROM (yet)!!!!!
+ */
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/string.h>
+
+#include <asm/sections.h>
+
+#include "klime.h"
+
+/* Volatility ordered acquisition. "System RAM" is cut into blocks which
+ * are ranked by the most volatile page they hold, and written out hottest
+ * first: kernel data and slab, then active anonymous memory, then dirty
+ * page cache, then everything else, and free memory last. Every run of
+ * blocks keeps its own lime header, so readers don't care about order. */
+
+int write_ordered(void);
+
+extern int write_class(resource_size_t, resource_size_t, int);
+
+extern lime_range ram_ranges[];
+extern int ram_count;
+
+#define LIME_SCHED_SHIFT	21 /* 2 MiB blocks */
+#define LIME_SCHED_BLOCK	(1UL << LIME_SCHED_SHIFT)
+
+#define LIME_PRIO_KERNEL	0
+#define LIME_PRIO_ANON		1
+#define LIME_PRIO_DIRTY		2
+#define LIME_PRIO_OTHER		3
+#define LIME_PRIO_FREE		4
+#define LIME_PRIO_COUNT		5
+
+static int page_prio(unsigned long pfn) {
+	struct page * page;
+
+	if (!pfn_valid(pfn))
+		return LIME_PRIO_FREE;
+
+	page = pfn_to_page(pfn);
+
+	if (PageBuddy(page) || !page_count(page))
+		return LIME_PRIO_FREE;
+
+	if (PageSlab(compound_head(page)))
+		return LIME_PRIO_KERNEL;
+
+	if (PageAnon(page))
+		return PageActive(page) ? LIME_PRIO_ANON : LIME_PRIO_OTHER;
+
+	if (page->mapping && (PageDirty(page) || PageWriteback(page)))
+		return LIME_PRIO_DIRTY;
+
+	return LIME_PRIO_OTHER;
+}
+
+static int block_prio(resource_size_t start, resource_size_t end) {
+	unsigned long pfn, kdata_s, kdata_e;
+	int prio = LIME_PRIO_FREE;
+
+	kdata_s = __pa(_sdata) >> PAGE_SHIFT;
+	kdata_e = __pa(_end) >> PAGE_SHIFT;
+
+	for (pfn = start >> PAGE_SHIFT; pfn <= end >> PAGE_SHIFT; pfn++) {
+		if (pfn >= kdata_s && pfn <= kdata_e)
+			return LIME_PRIO_KERNEL;
+
+		prio = min(prio, page_prio(pfn));
+
+		if (prio == LIME_PRIO_KERNEL)
+			break;
+	}
+
+	return prio;
+}
+
+/* Step to the next block of the dump's "System RAM" in physical order,
+ * starting from *r == -1. Every pass uses this, so block indices line up. */
+static int next_block(int *r, resource_size_t *s, resource_size_t *e) {
+	if (*r >= 0 && *e < ram_ranges[*r].end) {
+		*s = *e + 1;
+	} else {
+		if (++*r >= ram_count)
+			return 0;
+
+		*s = ram_ranges[*r].start;
+	}
+
+	*e = min_t(resource_size_t, ram_ranges[*r].end, *s | (LIME_SCHED_BLOCK - 1));
+
+	return 1;
+}
+
+int write_ordered() {
+	resource_size_t s, e, run_s = 0, run_e = 0;
+	unsigned char * prio;
+	unsigned long blocks = 0, i;
+	int r, level, in_run, err = 0;
+
+	for (r = -1; next_block(&r, &s, &e); )
+		blocks++;
+
+	if (!blocks)
+		return 0;
+
+	prio = vmalloc(blocks);
+	if (!prio)
+		return -ENOMEM;
+
+	for (i = 0, r = -1; next_block(&r, &s, &e); i++)
+		prio[i] = block_prio(s, e);
+
+	for (level = 0; level < LIME_PRIO_COUNT; level++) {
+		in_run = 0;
+
+		for (i = 0, r = -1; next_block(&r, &s, &e); i++) {
+			if (prio[i] != level)
+				continue;
+
+			if (in_run && s == run_e + 1) {
+				run_e = e;
+				continue;
+			}
+
+			if (in_run && (err = write_class(run_s, run_e, LIME_RANGE_RAM)))
+				goto out;
+
+			run_s = s;
+			run_e = e;
+			in_run = 1;
+		}
+
+		if (in_run && (err = write_class(run_s, run_e, LIME_RANGE_RAM)))
+			goto out;
+	}
+
+out:
+	vfree(prio);
+
+	return err;
+}
@@ -0,0 +1,264 @@
+/*
+ * LiME - Linux Memory Extractor
+ * Copyright (c) 2011-2013 Joe Sylve - 504ENSICS Labs
+ *
+ *
+ * Author(s):
+ * Joe Sylve       - joe.sylve@gmail.com, @jtsylve
+ * Jake Valletta   - javallet@gmail.com, @jake_valletta
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/* This fork of LiME allows Android applications and programs
+ * in userspace the ability to arbitrarily dump system memory using a
+ * device driver. All credit for LiME functionality goes to Joe;
+ * I simply created an API around it.
+ *
+ * A NOTE ON SECURITY:
+ * This initial fork of LiME lacks any UAC or security model.  The driver
+ * is accessible to userspace and applications.  Any application or
+ * program can link against the LiME code and potentially dump memory.
+ * This will be addressed in further releases.
+ *
+ * TL;DR - Don't install this on a production ROM (yet)!!!!!
+ */
+#include <linux/kernel.h>
+#include <linux/highmem.h>
+#include <linux/jiffies.h>
+#include <linux/vmalloc.h>
+#include <linux/string.h>
+
+#include "klime.h"
+
+/* Smear detection. Every LIME_CHUNK_SIZE chunk is hashed on the copy path
+ * and the time it was captured is noted. Once the dump is complete, every
+ * chunk is hashed again straight from memory; chunks whose contents moved
+ * on while the dump was running are recaptured as LIME_RANGE_RECAPTURE
+ * ranges at the end of the image, and listed in LIME_META_SMEAR records
+ * so analysts know which regions of the first pass can't be trusted. */
+
+int setup_smear(void);
+void cleanup_smear(void);
+void smear_vaddr(resource_size_t, const void *, size_t);
+int write_smear(void);
+
+extern int write_class(resource_size_t, resource_size_t, int);
+extern int write_meta(unsigned int, unsigned int, void *, size_t);
+extern size_t direct_span(resource_size_t, resource_size_t);
+
+extern struct resource iomem_resource;
+
+#define LIME_SMEAR_BUF	256
+
+struct lime_chunk {
+	unsigned long long paddr;
+	u64 hash;
+	unsigned int size;
+	unsigned int msecs;
+};
+
+static struct lime_chunk * chunks = NULL;
+static unsigned long chunk_max = 0;
+static unsigned long chunk_used = 0;
+static unsigned int chunk_flags = 0;
+
+static unsigned long smear_start = 0;
+static int recapturing = 0;
+
+static lime_smear_entry smear_buf[LIME_SMEAR_BUF];
+static int smear_used = 0;
+static unsigned long smeared = 0;
+
+static u64 hash_vaddr(u64 h, const void * v, size_t is) {
+	const unsigned char * b = v;
+	u64 w;
+
+	for (; is >= sizeof(u64); is -= sizeof(u64), b += sizeof(u64)) {
+		w = *(const u64 *) b;
+		h = (h ^ w) * 0x9E3779B97F4A7C15ULL;
+		h ^= h >> 29;
+	}
+
+	while (is--)
+		h = (h ^ *b++) * 0x9E3779B97F4A7C15ULL;
+
+	return h;
+}
+
+static u64 hash_chunk(resource_size_t paddr, unsigned int size) {
+	resource_size_t i, end = paddr + size;
+	struct page * p;
+	size_t is;
+	void * v;
+	u64 h = 0;
+
+	for (i = paddr; i < end; i += is) {
+		if ((is = direct_span(i, end - 1))) {
+			h = hash_vaddr(h, __va(i), is);
+			continue;
+		}
+
+		is = min_t(resource_size_t, PAGE_SIZE - (i & ~PAGE_MASK), end - i);
+
+		p = pfn_to_page(i >> PAGE_SHIFT);
+		v = kmap(p);
+		h = hash_vaddr(h, (char *) v + (i & ~PAGE_MASK), is);
+		kunmap(p);
+	}
+
+	return h;
+}
+
+int setup_smear() {
+	struct resource *p;
+	unsigned long long ram = 0;
+
+	for (p = iomem_resource.child; p ; p = p->sibling) {
+		if (!strncmp(p->name, LIME_RAMSTR, sizeof(LIME_RAMSTR)))
+			ram += p->end - p->start + 1;
+	}
+
+	// Room for every chunk of RAM plus the partial chunks at range edges
+	chunk_max = (unsigned long) (ram / LIME_CHUNK_SIZE) + 4096;
+	chunk_used = 0;
+	chunk_flags = 0;
+	smear_used = 0;
+	smeared = 0;
+	recapturing = 0;
+	smear_start = jiffies;
+
+	chunks = vmalloc(chunk_max * sizeof(struct lime_chunk));
+	if (!chunks)
+		return -ENOMEM;
+
+	return 0;
+}
+
+void cleanup_smear() {
+	vfree(chunks);
+	chunks = NULL;
+}
+
+void smear_vaddr(resource_size_t paddr, const void * v, size_t is) {
+	struct lime_chunk * c;
+	const char * b = v;
+	size_t n;
+
+	if (recapturing)
+		return;
+
+	while (is) {
+		c = chunk_used ? &chunks[chunk_used - 1] : NULL;
+
+		// New chunk on every chunk boundary or discontiguity
+		if (!c || paddr != c->paddr + c->size || !(paddr & (LIME_CHUNK_SIZE - 1))) {
+			if (chunk_used == chunk_max) {
+				chunk_flags |= LIME_META_TRUNCATED;
+				return;
+			}
+
+			c = &chunks[chunk_used++];
+			c->paddr = paddr;
+			c->hash = 0;
+			c->size = 0;
+		}
+
+		n = min_t(size_t, is, LIME_CHUNK_SIZE - (paddr & (LIME_CHUNK_SIZE - 1)));
+
+		c->hash = hash_vaddr(c->hash, b, n);
+		c->size += n;
+		c->msecs = jiffies_to_msecs(jiffies - smear_start);
+
+		paddr += n;
+		b += n;
+		is -= n;
+	}
+}
+
+static int flush_smear(void) {
+	int err;
+
+	err = write_meta(LIME_META_SMEAR, chunk_flags, smear_buf, smear_used * sizeof(lime_smear_entry));
+	smear_used = 0;
+
+	return err;
+}
+
+/* Recapture one run of changed chunks, then report each of them. */
+static int recapture(unsigned long first, unsigned long last) {
+	unsigned long i;
+	unsigned int msecs;
+	int err;
+
+	recapturing = 1;
+	err = write_class(chunks[first].paddr, chunks[last].paddr + chunks[last].size - 1, LIME_RANGE_RECAPTURE);
+	recapturing = 0;
+
+	if (err)
+		return err;
+
+	msecs = jiffies_to_msecs(jiffies - smear_start);
+
+	for (i = first; i <= last; i++) {
+		if (smear_used == LIME_SMEAR_BUF && (err = flush_smear()))
+			return err;
+
+		smear_buf[smear_used].paddr = chunks[i].paddr;
+		smear_buf[smear_used].size = chunks[i].size;
+		smear_buf[smear_used].captured = chunks[i].msecs;
+		smear_buf[smear_used].recaptured = msecs;
+		smear_buf[smear_used].reserved = 0;
+		smear_used++;
+		smeared++;
+	}
+
+	return 0;
+}
+
+int write_smear() {
+	unsigned long i, first = 0;
+	int in_run = 0, err;
+
+	for (i = 0; i < chunk_used; i++) {
+		// Runs only continue through physically contiguous chunks
+		if (in_run && chunks[i].paddr != chunks[i - 1].paddr + chunks[i - 1].size) {
+			if ((err = recapture(first, i - 1)))
+				return err;
+			in_run = 0;
+		}
+
+		if (hash_chunk(chunks[i].paddr, chunks[i].size) == chunks[i].hash) {
+			if (in_run && (err = recapture(first, i - 1)))
+				return err;
+			in_run = 0;
+			continue;
+		}
+
+		if (!in_run) {
+			first = i;
+			in_run = 1;
+		}
+	}
+
+	if (in_run && (err = recapture(first, chunk_used - 1)))
+		return err;
+
+	// Always end with a report, even an empty one, so readers know it ran
+	if (smear_used || !smeared)
+		return flush_smear();
+
+	return 0;
+}
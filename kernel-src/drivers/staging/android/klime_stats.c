@@ -0,0 +1,183 @@
+/*
+ * LiME - Linux Memory Extractor
+ * Copyright (c) 2011-2013 Joe Sylve - 504ENSICS Labs
+ *
+ *
+ * Author(s):
+ * Joe Sylve       - joe.sylve@gmail.com, @jtsylve
+ * Jake Valletta   - javallet@gmail.com, @jake_valletta
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/* This fork of LiME allows Android applications and programs
+ * in userspace the ability to arbitrarily dump system memory using a
+ * device driver. All credit for LiME functionality goes to Joe;
+ * I simply created an API around it.
+ *
+ * A NOTE ON SECURITY:
+ * This initial fork of LiME lacks any UAC or security model.  The driver
+ * is accessible to userspace and applications.  Any application or
+ * program can link against the LiME code and potentially dump memory.
+ * This will be addressed in further releases.
+ *
+ * TL;DR - Don't install this on a production ROM (yet)!!!!!
+ */
+#include <linux/kernel.h>
+#include <linux/bitops.h>
+#include <linux/math64.h>
+#include <linux/string.h>
+
+#include "klime.h"
+
+/* Per-chunk content statistics. Every LIME_CHUNK_SIZE chunk of physical
+ * memory gets a byte histogram on the copy path, from which its Shannon
+ * entropy, zero fraction and a rough content class are derived. Entries
+ * are written as LIME_META_ENTROPY records after each segment.
+ *
+ * Entropy is computed in 16.16 fixed point as
+ *     H = log2(n) - (1/n) * sum(c * log2(c))
+ * over the non-zero histogram buckets c. */
+
+int setup_stats(void);
+void stats_vaddr(resource_size_t, const void *, size_t);
+int flush_stats(void);
+
+extern int write_meta(unsigned int, unsigned int, void *, size_t);
+
+#define LIME_STATS_BUF	(LIME_SEGMENT_SIZE / LIME_CHUNK_SIZE + 2)
+
+static unsigned int hist[256];
+static resource_size_t chunk_start = 0;
+static unsigned int chunk_len = 0;
+
+static lime_entropy_entry stats_buf[LIME_STATS_BUF];
+static int stats_used = 0;
+
+/* log2(x) in 16.16 fixed point, by repeated squaring of the mantissa. */
+static unsigned int log2_fp(unsigned int x) {
+	unsigned int ip = fls(x) - 1, fp = 0;
+	u64 m = ((u64) x << 31) >> ip;
+	int i;
+
+	for (i = 15; i >= 0; i--) {
+		m = (m * m) >> 31;
+
+		if (m >= (1ULL << 32)) {
+			m >>= 1;
+			fp |= 1U << i;
+		}
+	}
+
+	return (ip << 16) | fp;
+}
+
+static unsigned char classify(unsigned int h, unsigned int zero, unsigned int text, unsigned int n) {
+	if (zero == n)
+		return LIME_CONTENT_ZERO;
+
+	if (text * 10 >= n * 9)
+		return LIME_CONTENT_TEXT;
+
+	if (h >= (7 << 16) + (9 << 16) / 10)
+		return LIME_CONTENT_ENCRYPTED;
+
+	if (h >= (7 << 16) + (2 << 16) / 10)
+		return LIME_CONTENT_COMPRESSED;
+
+	// Machine code sits in the middle of the range and has few zeros
+	if (h >= (5 << 16) && zero * 4 < n)
+		return LIME_CONTENT_CODE;
+
+	return LIME_CONTENT_DATA;
+}
+
+static void finish_chunk(void) {
+	lime_entropy_entry *e;
+	u64 sum = 0;
+	unsigned int h = 0, text = 0;
+	int c;
+
+	if (!chunk_len)
+		return;
+
+	for (c = 0; c < 256; c++) {
+		if (hist[c] > 1)
+			sum += (u64) hist[c] * log2_fp(hist[c]);
+
+		if ((c >= 0x20 && c < 0x7f) || c == '\t' || c == '\n' || c == '\r')
+			text += hist[c];
+	}
+
+	if (hist[0] != chunk_len)
+		h = log2_fp(chunk_len) - (unsigned int) div_u64(sum, chunk_len);
+
+	// Can't overflow; segments hold a bounded number of chunks
+	e = &stats_buf[stats_used++];
+	e->paddr = chunk_start;
+	e->size = chunk_len;
+	e->entropy = (unsigned short) (h >> 8);
+	e->zero = (unsigned char) (((u64) hist[0] * 255) / chunk_len);
+	e->class = classify(h, hist[0], text, chunk_len);
+
+	memset(hist, 0, sizeof(hist));
+	chunk_len = 0;
+}
+
+int setup_stats() {
+	memset(hist, 0, sizeof(hist));
+	chunk_len = 0;
+	stats_used = 0;
+
+	return 0;
+}
+
+void stats_vaddr(resource_size_t paddr, const void *v, size_t is) {
+	const unsigned char *b = v;
+	size_t i, n;
+
+	while (is) {
+		// New chunk on every chunk boundary or discontiguity
+		if (chunk_len && (paddr != chunk_start + chunk_len || !(paddr & (LIME_CHUNK_SIZE - 1))))
+			finish_chunk();
+
+		if (!chunk_len)
+			chunk_start = paddr;
+
+		n = min_t(size_t, is, LIME_CHUNK_SIZE - (paddr & (LIME_CHUNK_SIZE - 1)));
+
+		for (i = 0; i < n; i++)
+			hist[b[i]]++;
+
+		chunk_len += n;
+		paddr += n;
+		b += n;
+		is -= n;
+	}
+}
+
+int flush_stats() {
+	int err;
+
+	finish_chunk();
+
+	if (!stats_used)
+		return 0;
+
+	err = write_meta(LIME_META_ENTROPY, 0, stats_buf, stats_used * sizeof(lime_entropy_entry));
+	stats_used = 0;
+
+	return err;
+}
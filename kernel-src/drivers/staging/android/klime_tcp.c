@@ -141,7 +141,8 @@ void cleanup_tcp() {
 int write_vaddr_tcp(void * v, size_t is) {
 	mm_segment_t fs;
 
-	long s;
+	long s = 0;
+	size_t done = 0;
 
 	struct iovec iov;
 	struct msghdr msg  = { .msg_iov = &iov, .msg_iovlen = 1 };
@@ -149,12 +150,26 @@ int write_vaddr_tcp(void * v, size_t is) {
 	fs = get_fs();
 	set_fs(KERNEL_DS);
 
-	iov.iov_base = v;	
-	iov.iov_len = is;
-    
-	s = sock_sendmsg(accept, &msg, is);
+	// Direct map spans are large enough to be sent in pieces
+	while (done < is) {
+		iov.iov_base = (char *) v + done;
+		iov.iov_len = is - done;
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+
+		s = sock_sendmsg(accept, &msg, is - done);
+
+		if (s <= 0)
+			break;
+
+		done += s;
+	}
 
 	set_fs(fs);
 
-	return s;
+	// A send that moves nothing would otherwise read as success
+	if (done < is && s == 0)
+		s = -EIO;
+
+	return (done == is) ? is : s;
 }
@@ -0,0 +1,206 @@
+/*
+ * LiME - Linux Memory Extractor
+ * Copyright (c) 2011-2013 Joe Sylve - 504ENSICS Labs
+ *
+ *
+ * Author(s):
+ * Joe Sylve       - joe.sylve@gmail.com, @jtsylve
+ * Jake Valletta   - javallet@gmail.com, @jake_valletta
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/* This fork of LiME allows Android applications and programs
+ * in userspace the ability to arbitrarily dump system memory using a
+ * device driver. All credit for LiME functionality goes to Joe;
+ * I simply created an API around it.
+ *
+ * A NOTE ON SECURITY:
+ * This initial fork of LiME lacks any UAC or security model.  The driver
+ * is accessible to userspace and applications.  Any application or
+ * program can link against the LiME code and potentially dump memory.
+ * This will be addressed in further releases.
+ *
+ * TL;DR - Don't install this on a production ROM (yet)!!!!!
+ */
+
+/* Static tracepoints for the acquisition hot paths, under events/lime/.
+ * klime_main.c instantiates them, which needs this directory on its
+ * include path (CFLAGS_klime_main.o := -I$(src)). */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM lime
+
+#if !defined(_KLIME_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _KLIME_TRACE_H
+
+#include <linux/tracepoint.h>
+#include <linux/version.h>
+
+/* Only time a sink call when someone is listening. Before 3.17 there is
+ * no trace_<name>_enabled(), so test the tracepoint's key (or its state
+ * before jump labels) the way trace_<name>() does itself. */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,17,0)
+#define lime_trace_timed(name) trace_##name##_enabled()
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(3,3,0)
+#define lime_trace_timed(name) static_key_false(&__tracepoint_##name.key)
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(3,0,0)
+#define lime_trace_timed(name) static_branch(&__tracepoint_##name.key)
+#else
+#define lime_trace_timed(name) unlikely(__tracepoint_##name.state)
+#endif
+
+TRACE_EVENT(lime_range_start,
+
+	TP_PROTO(u64 start, u64 end),
+
+	TP_ARGS(start, end),
+
+	TP_STRUCT__entry(
+		__field(u64, start)
+		__field(u64, end)
+	),
+
+	TP_fast_assign(
+		__entry->start = start;
+		__entry->end = end;
+	),
+
+	TP_printk("start=0x%llx end=0x%llx",
+		(unsigned long long) __entry->start, (unsigned long long) __entry->end)
+);
+
+TRACE_EVENT(lime_range_end,
+
+	TP_PROTO(u64 start, u64 end, int err),
+
+	TP_ARGS(start, end, err),
+
+	TP_STRUCT__entry(
+		__field(u64, start)
+		__field(u64, end)
+		__field(int, err)
+	),
+
+	TP_fast_assign(
+		__entry->start = start;
+		__entry->end = end;
+		__entry->err = err;
+	),
+
+	TP_printk("start=0x%llx end=0x%llx err=%d",
+		(unsigned long long) __entry->start, (unsigned long long) __entry->end, __entry->err)
+);
+
+TRACE_EVENT(lime_batch,
+
+	TP_PROTO(u64 paddr, size_t len, int direct),
+
+	TP_ARGS(paddr, len, direct),
+
+	TP_STRUCT__entry(
+		__field(u64, paddr)
+		__field(size_t, len)
+		__field(int, direct)
+	),
+
+	TP_fast_assign(
+		__entry->paddr = paddr;
+		__entry->len = len;
+		__entry->direct = direct;
+	),
+
+	TP_printk("paddr=0x%llx len=%zu %s",
+		(unsigned long long) __entry->paddr, __entry->len, __entry->direct ? "direct" : "kmap")
+);
+
+TRACE_EVENT(lime_sink,
+
+	TP_PROTO(int method, size_t len, long ret, u64 ns),
+
+	TP_ARGS(method, len, ret, ns),
+
+	TP_STRUCT__entry(
+		__field(int, method)
+		__field(size_t, len)
+		__field(long, ret)
+		__field(u64, ns)
+	),
+
+	TP_fast_assign(
+		__entry->method = method;
+		__entry->len = len;
+		__entry->ret = ret;
+		__entry->ns = ns;
+	),
+
+	TP_printk("%s len=%zu ret=%ld ns=%llu",
+		__print_symbolic(__entry->method,
+			{ LIME_METHOD_TCP, "tcp" }, { LIME_METHOD_DISK, "disk" }, { LIME_METHOD_FD, "fd" }),
+		__entry->len, __entry->ret, (unsigned long long) __entry->ns)
+);
+
+/* Segmented disk output copies into a ring in lime_sink; the writes to
+ * the segments happen on the workqueue and are traced here. */
+TRACE_EVENT(lime_segment_write,
+
+	TP_PROTO(int seg, u64 pos, size_t len, long ret, u64 ns),
+
+	TP_ARGS(seg, pos, len, ret, ns),
+
+	TP_STRUCT__entry(
+		__field(int, seg)
+		__field(u64, pos)
+		__field(size_t, len)
+		__field(long, ret)
+		__field(u64, ns)
+	),
+
+	TP_fast_assign(
+		__entry->seg = seg;
+		__entry->pos = pos;
+		__entry->len = len;
+		__entry->ret = ret;
+		__entry->ns = ns;
+	),
+
+	TP_printk("seg=%d pos=%llu len=%zu ret=%ld ns=%llu", __entry->seg,
+		(unsigned long long) __entry->pos, __entry->len, __entry->ret, (unsigned long long) __entry->ns)
+);
+
+TRACE_EVENT(lime_dio_fallback,
+
+	TP_PROTO(long ret, size_t len),
+
+	TP_ARGS(ret, len),
+
+	TP_STRUCT__entry(
+		__field(long, ret)
+		__field(size_t, len)
+	),
+
+	TP_fast_assign(
+		__entry->ret = ret;
+		__entry->len = len;
+	),
+
+	TP_printk("ret=%ld len=%zu", __entry->ret, __entry->len)
+);
+
+#endif /* _KLIME_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#define TRACE_INCLUDE_FILE klime_trace
+#include <trace/define_trace.h>
@@ -0,0 +1,264 @@
+/*
+ * LiME - Linux Memory Extractor
+ * Copyright (c) 2011-2013 Joe Sylve - 504ENSICS Labs
+ *
+ *
+ * Author(s):
+ * Joe Sylve       - joe.sylve@gmail.com, @jtsylve
+ * Jake Valletta   - javallet@gmail.com, @jake_valletta
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/* This fork of LiME allows Android applications and programs
+ * in userspace the ability to arbitrarily dump system memory using a
+ * device driver. All credit for LiME functionality goes to Joe;
+ * I simply created an API around it.
+ *
+ * A NOTE ON SECURITY:
+ * This initial fork of LiME lacks any UAC or security model.  The driver
+ * is accessible to userspace and applications.  Any application or
+ * program can link against the LiME code and potentially dump memory.
+ * This will be addressed in further releases.
+ *
+ * TL;DR - Don't install this on a production ROM (yet)!!!!!
+ */
+
+#include <linux/kernel.h>
+#include <linux/version.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/bit_spinlock.h>
+#include <linux/vmalloc.h>
+#include <linux/string.h>
+
+#include "klime.h"
+
+/* The zram index. Every slot of every initialized zram device is listed
+ * with the physical address of its compressed object, so analysis can
+ * decompress single swapped out pages from the image instead of carving
+ * the pool. A slot's index is its swap offset when the device is used
+ * as swap; process dumps record swap ptes to complete the mapping from
+ * (pid, vaddr). Objects that straddle two zsmalloc pages, or sit in
+ * highmem, have no single address and are flagged instead.
+ *
+ * Each device's header carries the swap type it is active as, which is
+ * what swap ptes record, so the join holds with several swap devices.
+ *
+ * zram keeps its tables private, so this follows the zram_meta layout
+ * of 3.10 to 4.11 and is a stub elsewhere. 4.12 folded zram_meta into
+ * struct zram. */
+
+int write_zram(void);
+
+extern int write_meta(unsigned int, unsigned int, void *, size_t);
+
+#if defined(CONFIG_ZRAM) && LINUX_VERSION_CODE >= KERNEL_VERSION(3,10,0) && \
+    LINUX_VERSION_CODE < KERNEL_VERSION(4,12,0)
+
+#include <linux/swap.h>
+#include <linux/swapfile.h>
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,14,0)
+#include "../../block/zram/zram_drv.h"
+#else
+#include "../zram/zram_drv.h"
+#endif
+
+#define LIME_ZRAM_DEVICES	8
+#define LIME_ZRAM_BUF		4096
+
+static lime_zram_header * zram_buf = NULL;
+static lime_zram_entry * zram_entries = NULL;
+
+static int flush_zram(void) {
+	int err;
+
+	if (!zram_buf->count)
+		return 0;
+
+	err = write_meta(LIME_META_ZRAM, 0, zram_buf,
+			 sizeof(lime_zram_header) + zram_buf->count * sizeof(lime_zram_entry));
+	zram_buf->count = 0;
+
+	return err;
+}
+
+/* Fill e from slot i. The slot is locked, so this must not sleep. */
+static void read_slot(struct zram * zram, struct zram_meta * meta, u32 i, lime_zram_entry * e) {
+	unsigned long handle;
+	void * v;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,17,0)
+	handle = meta->table[i].handle;
+	e->size = meta->table[i].value & (BIT(ZRAM_FLAG_SHIFT) - 1);
+
+	if (meta->table[i].value & BIT(ZRAM_ZERO))
+		e->flags |= LIME_ZRAM_ZERO;
+#else
+	handle = meta->table[i].handle;
+	e->size = meta->table[i].size;
+
+	if (meta->table[i].flags & BIT(ZRAM_ZERO))
+		e->flags |= LIME_ZRAM_ZERO;
+#endif
+
+	if (!handle)
+		return;
+
+	v = zs_map_object(meta->mem_pool, handle, ZS_MM_RO);
+
+	// Split objects are copied into a per-cpu buffer, highmem is kmapped
+	if (virt_addr_valid(v) && offset_in_page(v) + e->size <= PAGE_SIZE)
+		e->paddr = __pa(v);
+	else
+		e->flags |= LIME_ZRAM_SPLIT;
+
+	zs_unmap_object(meta->mem_pool, handle);
+}
+
+/* The swap type bdev is active as, or -1 */
+static int swap_type(struct block_device * bdev) {
+	struct swap_info_struct * si;
+	int type, found = -1;
+
+	spin_lock(&swap_lock);
+
+	for (type = 0; type < MAX_SWAPFILES && found < 0; type++) {
+		si = swap_info[type];
+
+		if (si && (si->flags & SWP_USED) && si->bdev && si->bdev->bd_disk == bdev->bd_disk)
+			found = type;
+	}
+
+	spin_unlock(&swap_lock);
+
+	return found;
+}
+
+static int index_device(int device, struct block_device * bdev) {
+	struct zram * zram = bdev->bd_disk->private_data;
+	struct zram_meta * meta;
+	lime_zram_entry * e;
+	u32 i, slots;
+	int err = 0;
+
+	down_read(&zram->init_lock);
+
+	meta = zram->meta;
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(3,15,0)
+	if (!zram->init_done)
+		meta = NULL;
+#endif
+
+	if (!meta)
+		goto out;
+
+	zram_buf->device = device;
+	zram_buf->swap_type = swap_type(bdev);
+	zram_buf->count = 0;
+	memset(zram_buf->compressor, 0, sizeof(zram_buf->compressor));
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,15,0)
+	strlcpy(zram_buf->compressor, zram->compressor, sizeof(zram_buf->compressor));
+#else
+	strlcpy(zram_buf->compressor, "lzo", sizeof(zram_buf->compressor));
+#endif
+
+	slots = zram->disksize >> PAGE_SHIFT;
+
+	for (i = 0; i < slots; i++) {
+		e = &zram_entries[zram_buf->count];
+		memset(e, 0, sizeof(lime_zram_entry));
+		e->index = i;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,17,0)
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[i].value);
+		read_slot(zram, meta, i, e);
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[i].value);
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(3,15,0)
+		read_lock(&meta->tb_lock);
+		read_slot(zram, meta, i, e);
+		read_unlock(&meta->tb_lock);
+#else
+		down_read(&zram->lock);
+		read_slot(zram, meta, i, e);
+		up_read(&zram->lock);
+#endif
+
+		// Unused slots aren't worth an entry
+		if (!e->paddr && !e->flags)
+			continue;
+
+		if (++zram_buf->count == LIME_ZRAM_BUF && (err = flush_zram()))
+			goto out;
+	}
+
+	err = flush_zram();
+
+out:
+	up_read(&zram->init_lock);
+
+	return err;
+}
+
+static struct block_device * open_zram(int device) {
+	static const char * const fmts[] = { "/dev/block/zram%d", "/dev/zram%d" };
+	struct block_device * bdev = ERR_PTR(-ENODEV);
+	char name[32];
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(fmts) && IS_ERR(bdev); i++) {
+		snprintf(name, sizeof(name), fmts[i], device);
+		bdev = blkdev_get_by_path(name, FMODE_READ, NULL);
+	}
+
+	return bdev;
+}
+
+int write_zram() {
+	struct block_device * bdev;
+	int i, err = 0;
+
+	zram_buf = vmalloc(sizeof(lime_zram_header) + LIME_ZRAM_BUF * sizeof(lime_zram_entry));
+	if (!zram_buf)
+		return -ENOMEM;
+
+	zram_entries = (lime_zram_entry *) (zram_buf + 1);
+
+	for (i = 0; i < LIME_ZRAM_DEVICES && !err; i++) {
+		bdev = open_zram(i);
+		if (IS_ERR(bdev))
+			continue;
+
+		err = index_device(i, bdev);
+		blkdev_put(bdev, FMODE_READ);
+	}
+
+	vfree(zram_buf);
+	zram_buf = NULL;
+	zram_entries = NULL;
+
+	return err;
+}
+
+#else
+
+int write_zram() {
+	DBG("zram indexing is not supported on this kernel");
+	return -EOPNOTSUPP;
+}
+
+#endif
@@ -5,11 +5,21 @@ LOCAL_PATH:= $(call my-dir)
 include $(CLEAR_VARS)
 
 LOCAL_MODULE_TAGS := eng
-LOCAL_SRC_FILES:= lime.c
+LOCAL_SRC_FILES:= lime.c lime_image.c lime_convert.c lime_diff.c
 LOCAL_MODULE := lime
 LOCAL_STATIC_LIBRARIES := liblime liblog
 
 include $(BUILD_EXECUTABLE)
 
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := eng
+LOCAL_SRC_FILES:= lime_decrypt.c
+LOCAL_MODULE := limedecrypt
+LOCAL_C_INCLUDES := external/openssl/include
+LOCAL_SHARED_LIBRARIES := libcrypto
+
+include $(BUILD_EXECUTABLE)
+
 endif  # TARGET_SIMULATOR != true
 
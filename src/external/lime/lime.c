@@ -21,33 +21,73 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include <jakev/lime.h>
 
 #define PROJECT_NAME "lime"
 
+extern int convert_main(int, char **);
+extern int diff_main(int, char **);
+
 static int mode = 0;
 static int method = 0;
 
 static char path[LIME_MAX_FILENAME_SIZE];
 static int dio = 1;
 static int port = 0;
+static int out_fd = -1;
+static int pids[LIME_MAX_PIDS];
+static int pid_count = 0;
+static lime_dump_opts opts;
+static unsigned long long segment_size = 0;
+static int have_key = 0;
+
+/* Whether fd is where our own messages go */
+static int is_stdout(int fd)
+{
+   struct stat a, b;
+
+   if (fd == STDOUT_FILENO)
+      return 1;
+
+   return fstat(fd, &a) == 0 && fstat(STDOUT_FILENO, &b) == 0 && a.st_dev == b.st_dev && a.st_ino == b.st_ino;
+}
 
 static void usage(void)
 {
    fprintf(stdout, "LiME Command Line Utility\n");
    fprintf(stdout, "Usage: %s [-h] [OPTIONS] [MODE]\n", PROJECT_NAME);
+   fprintf(stdout, "       %s convert [-h] [OPTIONS] [input] [output]\n", PROJECT_NAME);
+   fprintf(stdout, "       %s diff [-h] [OPTIONS] [old] [new] [bitmap]\n", PROJECT_NAME);
 
    fprintf(stdout, "  MODES:\n");
    fprintf(stdout, "   -t[port]          Write data to network socket.\n");
    fprintf(stdout, "   -d[filename]      Write data to file specified.\n");
+   fprintf(stdout, "   -F[fd]            Write data to an inherited file descriptor (e.g. -F3 3>out, or 3>&1 >&2 | nc).\n");
    fprintf(stdout, "   -r                Check if LiME is ready and exit.\n");
+   fprintf(stdout, "   -m                Print the System RAM map and expected image sizes, then exit.\n");
    fprintf(stdout, "\n");
 
    fprintf(stdout, "  OPTIONS:\n");
    fprintf(stdout, "   -h                    Show this help message and exit.\n");
    fprintf(stdout, "   -f[raw|padded|lime]   Output format.\n");
    fprintf(stdout, "   -i                    Disable direct IO attempt.\n");
+   fprintf(stdout, "   -p[pid,...]           Only dump pages mapped by these processes (lime format).\n");
+   fprintf(stdout, "   -k[first|only]        Dump kernel image and slab ranges first, or only (lime format).\n");
+   fprintf(stdout, "   -s[string]            Search for a string while dumping, may be repeated (lime format).\n");
+   fprintf(stdout, "   -x[hex]               Search for a hex encoded byte pattern while dumping (lime format).\n");
+   fprintf(stdout, "   -e                    Emit per-chunk entropy and content classes (lime format).\n");
+   fprintf(stdout, "   -o                    Dump the most volatile memory first (lime format).\n");
+   fprintf(stdout, "   -v                    Re-verify the image and recapture regions that changed (lime format).\n");
+   fprintf(stdout, "   -b                    Record page table root, kernel base, KASLR offset and banner first (lime format).\n");
+   fprintf(stdout, "   -Z                    Index compressed zram objects; with -p, also record swapped out pages (lime format).\n");
+   fprintf(stdout, "   -P                    Record flags, mapcount, order and class of every page frame (lime format).\n");
+   fprintf(stdout, "   -c[gcm|chacha]        Encrypt the image (AES-256-GCM or ChaCha20-Poly1305), needs -K.\n");
+   fprintf(stdout, "   -K[hex|@file]         256 bit key, as hex or read from a file. Decrypt with limedecrypt.\n");
+   fprintf(stdout, "   -z[megabytes]         Split a disk dump into preallocated segments of this size.\n");
+   fprintf(stdout, "   -w[start-end,...]     Only dump System RAM inside these physical windows (hex, inclusive).\n");
    fprintf(stdout, "\n");
    fprintf(stdout, "  Formats:\n");
    fprintf(stdout, "    raw	Simply concatentates all System RAM ranges (default).\n");
@@ -77,9 +117,33 @@ static void is_ready(void)
    }
 }
 
+static void print_ram_map(void)
+{
+   lime_ram_map map;
+   int i;
+
+   memset(&map, 0, sizeof(map));
+
+   if (__get_ram_map(&map) < 0)
+   {
+      fprintf(stderr, "Unable to read the System RAM map!\n");
+      exit(EXIT_FAILURE);
+   }
+
+   for (i = 0; i < map.count; i++)
+      fprintf(stdout, "0x%016llx-0x%016llx\n", map.ranges[i].start, map.ranges[i].end);
+
+   fprintf(stdout, "raw:    %llu bytes\n", map.size_raw);
+   fprintf(stdout, "padded: %llu bytes\n", map.size_padded);
+   fprintf(stdout, "lime:   %llu bytes\n", map.size_lime);
+}
+
 static int dump_to_disk(void)
 {
-   return __dump_memory_disk(path, mode, dio);
+   if (pid_count > 0)
+      return __dump_memory_proc_disk(path, mode, dio, pids, pid_count, &opts);
+
+   return __dump_memory_disk_segmented(path, mode, dio, segment_size, &opts);
 }
 
 static int dump_to_tcp(void)
@@ -91,7 +155,177 @@ static int dump_to_tcp(void)
       exit(EXIT_FAILURE);
    }
 
-   return __dump_memory_tcp(port, mode, dio);
+   if (pid_count > 0)
+      return __dump_memory_proc_tcp(port, mode, dio, pids, pid_count, &opts);
+
+   return __dump_memory_tcp_opts(port, mode, dio, &opts);
+}
+
+static int dump_to_fd(void)
+{
+   if (pid_count > 0)
+   {
+      fprintf(stderr, "Process mode can not write to a file descriptor!\n");
+      exit(EXIT_FAILURE);
+   }
+
+   return __dump_memory_fd(out_fd, mode, &opts);
+}
+
+static void parse_pids(const char *list)
+{
+   char *tmp, *tok, *save;
+
+   tmp = strdup(list);
+
+   for (tok = strtok_r(tmp, ",", &save); tok; tok = strtok_r(NULL, ",", &save))
+   {
+      if (pid_count == LIME_MAX_PIDS)
+      {
+         fprintf(stderr, "At most %d processes can be dumped!\n", LIME_MAX_PIDS);
+         exit(EXIT_FAILURE);
+      }
+
+      pids[pid_count] = atoi(tok);
+
+      if (pids[pid_count] <= 0)
+      {
+         fprintf(stderr, "Invalid process id: %s\n", tok);
+         exit(EXIT_FAILURE);
+      }
+
+      pid_count++;
+   }
+
+   free(tmp);
+}
+
+static void parse_windows(const char *list)
+{
+   char *tmp, *tok, *save, *end, *last;
+   lime_range *w;
+
+   tmp = strdup(list);
+
+   for (tok = strtok_r(tmp, ",", &save); tok; tok = strtok_r(NULL, ",", &save))
+   {
+      if (opts.window_count == LIME_MAX_RANGES)
+      {
+         fprintf(stderr, "At most %d windows are supported!\n", LIME_MAX_RANGES);
+         exit(EXIT_FAILURE);
+      }
+
+      w = &opts.windows[opts.window_count];
+      w->start = strtoull(tok, &end, 16);
+
+      if (end == tok || *end != '-')
+      {
+         fprintf(stderr, "Invalid window: %s\n", tok);
+         exit(EXIT_FAILURE);
+      }
+
+      last = end + 1;
+      w->end = strtoull(last, &end, 16);
+
+      if (end == last || *end != '\0' || w->end < w->start)
+      {
+         fprintf(stderr, "Invalid window: %s\n", tok);
+         exit(EXIT_FAILURE);
+      }
+
+      opts.window_count++;
+   }
+
+   free(tmp);
+}
+
+static int parse_hex(const char *hex, unsigned char *out, size_t len)
+{
+   unsigned int i, byte;
+
+   if (strlen(hex) != len * 2)
+      return -1;
+
+   for (i = 0; i < len; i++)
+   {
+      if (sscanf(&hex[i * 2], "%2x", &byte) != 1)
+         return -1;
+
+      out[i] = (unsigned char)byte;
+   }
+
+   return 0;
+}
+
+static lime_pattern *next_pattern(void)
+{
+   if (opts.pattern_count == LIME_MAX_PATTERNS)
+   {
+      fprintf(stderr, "At most %d search patterns are supported!\n", LIME_MAX_PATTERNS);
+      exit(EXIT_FAILURE);
+   }
+
+   return &opts.patterns[opts.pattern_count++];
+}
+
+static void add_string_pattern(const char *str)
+{
+   lime_pattern *p = next_pattern();
+   size_t len = strlen(str);
+
+   if (len > LIME_MAX_PATTERN_LEN)
+   {
+      fprintf(stderr, "Search patterns are limited to %d bytes!\n", LIME_MAX_PATTERN_LEN);
+      exit(EXIT_FAILURE);
+   }
+
+   memcpy(p->data, str, len);
+   p->len = len;
+}
+
+static void add_hex_pattern(const char *hex)
+{
+   lime_pattern *p = next_pattern();
+   size_t len = strlen(hex);
+
+   if (len % 2 || len / 2 > LIME_MAX_PATTERN_LEN)
+   {
+      fprintf(stderr, "Invalid hex pattern: %s\n", hex);
+      exit(EXIT_FAILURE);
+   }
+
+   if (parse_hex(hex, p->data, len / 2) != 0)
+   {
+      fprintf(stderr, "Invalid hex pattern: %s\n", hex);
+      exit(EXIT_FAILURE);
+   }
+
+   p->len = len / 2;
+}
+
+static void parse_key(const char *arg)
+{
+   FILE *fp;
+
+   if (arg[0] == '@')
+   {
+      fp = fopen(&arg[1], "rb");
+
+      if (!fp || fread(opts.key, 1, LIME_KEY_SIZE, fp) != LIME_KEY_SIZE)
+      {
+         fprintf(stderr, "Couldn't read a %d byte key from %s\n", LIME_KEY_SIZE, &arg[1]);
+         exit(EXIT_FAILURE);
+      }
+
+      fclose(fp);
+   }
+   else if (parse_hex(arg, opts.key, LIME_KEY_SIZE) != 0)
+   {
+      fprintf(stderr, "The key must be %d hex digits!\n", LIME_KEY_SIZE * 2);
+      exit(EXIT_FAILURE);
+   }
+
+   have_key = 1;
 }
 
 static void parse_args(int argc, char *argv[])
@@ -139,6 +373,28 @@ static void parse_args(int argc, char *argv[])
                       x = 1;
                       break;
 
+                   case 'F':
+                      if (m + 1 >= l || atoi(&argv[n][m+1]) < 0)
+                      {
+                         fprintf(stderr, "Argument \"-F\" requires a file descriptor!\n");
+                         exit(EXIT_FAILURE);
+                      }
+
+                      out_fd = atoi(&argv[n][m+1]);
+
+                      // The messages printed along the way would end up in the image
+                      if (is_stdout(out_fd))
+                      {
+                         fprintf(stderr, "Argument \"-F\" can not be stdout, move stdout aside (e.g. -F3 3>&1 >&2)!\n");
+                         exit(EXIT_FAILURE);
+                      }
+
+                      fprintf(stdout, "File descriptor mode selected: fd %d\n", out_fd);
+                      method = LIME_METHOD_FD;
+
+                      x = 1;
+                      break;
+
                    case 'd': 
                       if (m + 1 >= l)
                       {
@@ -192,6 +448,148 @@ static void parse_args(int argc, char *argv[])
                       is_ready();
                       exit(EXIT_SUCCESS);
 
+                   case 'm':
+                      print_ram_map();
+                      exit(EXIT_SUCCESS);
+
+                   case 'w':
+                      if (m + 1 >= l)
+                      {
+                         fprintf(stderr, "Argument \"-w\" requires a list of windows!\n");
+                         exit(EXIT_FAILURE);
+                      }
+
+                      parse_windows(&argv[n][m+1]);
+                      fprintf(stdout, "Physical windows: %d\n", opts.window_count);
+
+                      x = 1;
+                      break;
+
+                   case 'p':
+                      if (m + 1 >= l)
+                      {
+                         fprintf(stderr, "Argument \"-p\" requires a list of process ids!\n");
+                         exit(EXIT_FAILURE);
+                      }
+
+                      parse_pids(&argv[n][m+1]);
+                      fprintf(stdout, "Process mode selected: %d process(es)\n", pid_count);
+
+                      x = 1;
+                      break;
+
+                   case 'k':
+                      if (m + 1 >= l)
+                      {
+                         fprintf(stderr, "Argument \"-k\" requires \"first\" or \"only\"!\n");
+                         exit(EXIT_FAILURE);
+                      }
+                      else if (strcmp(&argv[n][m+1], "first") == 0)
+                         opts.triage = LIME_TRIAGE_FIRST;
+                      else if (strcmp(&argv[n][m+1], "only") == 0)
+                         opts.triage = LIME_TRIAGE_ONLY;
+                      else
+                      {
+                         fprintf(stderr, "Unknown triage mode: %s\n", &argv[n][m+1]);
+                         usage();
+                         exit(EXIT_FAILURE);
+                      }
+
+                      fprintf(stdout, "Kernel triage: %s\n", &argv[n][m+1]);
+                      x = 1;
+                      break;
+
+                   case 's':
+                   case 'x':
+                      if (m + 1 >= l)
+                      {
+                         fprintf(stderr, "Argument \"-%c\" requires a pattern!\n", ch);
+                         exit(EXIT_FAILURE);
+                      }
+
+                      if (ch == 's')
+                         add_string_pattern(&argv[n][m+1]);
+                      else
+                         add_hex_pattern(&argv[n][m+1]);
+
+                      fprintf(stdout, "Search pattern %d: %s\n", opts.pattern_count - 1, &argv[n][m+1]);
+                      x = 1;
+                      break;
+
+                   case 'e':
+                      opts.entropy = 1;
+                      fprintf(stdout, "Entropy map is enabled.\n");
+                      break;
+
+                   case 'o':
+                      opts.order = LIME_ORDER_VOLATILITY;
+                      fprintf(stdout, "Volatility ordering is enabled.\n");
+                      break;
+
+                   case 'v':
+                      opts.smear = 1;
+                      fprintf(stdout, "Smear detection is enabled.\n");
+                      break;
+
+                   case 'b':
+                      opts.boot = 1;
+                      fprintf(stdout, "Bootstrap record is enabled.\n");
+                      break;
+
+                   case 'Z':
+                      opts.zram = 1;
+                      fprintf(stdout, "zram indexing is enabled.\n");
+                      break;
+
+                   case 'P':
+                      opts.pfn_meta = 1;
+                      fprintf(stdout, "Page frame metadata is enabled.\n");
+                      break;
+
+                   case 'c':
+                      if (m + 1 >= l)
+                      {
+                         fprintf(stderr, "Argument \"-c\" requires a cipher!\n");
+                         exit(EXIT_FAILURE);
+                      }
+                      else if (strcmp(&argv[n][m+1], "gcm") == 0)
+                         opts.cipher = LIME_CIPHER_AES_GCM;
+                      else if (strcmp(&argv[n][m+1], "chacha") == 0)
+                         opts.cipher = LIME_CIPHER_CHACHA20_POLY1305;
+                      else
+                      {
+                         fprintf(stderr, "Unknown cipher: %s\n", &argv[n][m+1]);
+                         usage();
+                         exit(EXIT_FAILURE);
+                      }
+
+                      fprintf(stdout, "Encryption: %s\n", &argv[n][m+1]);
+                      x = 1;
+                      break;
+
+                   case 'K':
+                      if (m + 1 >= l)
+                      {
+                         fprintf(stderr, "Argument \"-K\" requires a key!\n");
+                         exit(EXIT_FAILURE);
+                      }
+
+                      parse_key(&argv[n][m+1]);
+                      x = 1;
+                      break;
+
+                   case 'z':
+                      if (m + 1 >= l || atoi(&argv[n][m+1]) <= 0)
+                      {
+                         fprintf(stderr, "Argument \"-z\" requires a segment size in megabytes!\n");
+                         exit(EXIT_FAILURE);
+                      }
+
+                      segment_size = (unsigned long long)atoi(&argv[n][m+1]) << 20;
+                      fprintf(stdout, "Segment size: %s MB\n", &argv[n][m+1]);
+                      x = 1;
+                      break;
+
                    case 'i':
                       dio = 0;
                       fprintf(stdout, "Direct I/O attempt is disabled.\n");
@@ -221,9 +619,48 @@ int main(int argc, char *argv[])
 {
    int ret_val = 0;
 
+   // Converting and comparing images don't involve the device
+   if (argc > 1 && strcmp(argv[1], "convert") == 0)
+      return convert_main(argc - 1, &argv[1]);
+
+   if (argc > 1 && strcmp(argv[1], "diff") == 0)
+      return diff_main(argc - 1, &argv[1]);
+
    // Parse all the arguments
    parse_args(argc, argv);
 
+   // These only make sense with addresses attached
+   if ((pid_count > 0 || opts.triage != LIME_TRIAGE_OFF || opts.pattern_count > 0 || opts.entropy ||
+        opts.smear || opts.pfn_meta || opts.boot || opts.zram || opts.order != LIME_ORDER_PHYSICAL) && mode != LIME_MODE_LIME)
+   {
+      fprintf(stdout, "The options given require the lime format, using it.\n");
+      mode = LIME_MODE_LIME;
+   }
+
+   if (pid_count > 0 && (opts.triage != LIME_TRIAGE_OFF || opts.order != LIME_ORDER_PHYSICAL))
+   {
+      fprintf(stderr, "Triage and ordering can not be combined with process mode!\n");
+      exit(EXIT_FAILURE);
+   }
+
+   if (opts.window_count > 0 && (pid_count > 0 || opts.triage != LIME_TRIAGE_OFF))
+   {
+      fprintf(stderr, "Windows can not be combined with process or triage mode!\n");
+      exit(EXIT_FAILURE);
+   }
+
+   if (opts.cipher != LIME_CIPHER_NONE && !have_key)
+   {
+      fprintf(stderr, "Encryption requires a key (\"-K\")!\n");
+      exit(EXIT_FAILURE);
+   }
+
+   if (opts.cipher != LIME_CIPHER_NONE && segment_size)
+   {
+      fprintf(stderr, "Encryption can not be combined with segmented output!\n");
+      exit(EXIT_FAILURE);
+   }
+
    // We need a format
    switch(method)
    {
@@ -237,8 +674,13 @@ int main(int argc, char *argv[])
          ret_val = dump_to_tcp();
          break;
 
+      case LIME_METHOD_FD:
+         fprintf(stdout, "About to dump memory to fd %d...\n", out_fd);
+         ret_val = dump_to_fd();
+         break;
+
       default:
-         fprintf(stderr, "You must supply either \"-t\" or \"-d\"!\n");
+         fprintf(stderr, "You must supply either \"-t\", \"-d\" or \"-F\"!\n");
          usage();
          exit(EXIT_FAILURE);
    }
@@ -0,0 +1,394 @@
+/*
+ * "lime convert" - Convert images between the LiME output formats
+ * Copyright (c) 2013 Jake Valletta
+ *
+ *
+ * Author:
+ * Jake Valletta     -javallet@gmail.com, @jake_valletta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include <jakev/lime.h>
+
+#include "lime_image.h"
+
+#define PROJECT_NAME "lime convert"
+
+/* Work is handed to the threads in pieces of this size, so at most
+ * threads * CONVERT_CHUNK of the input is mapped at any time. */
+#define CONVERT_CHUNK       (4 << 20)
+#define CONVERT_MAX_THREADS 16
+
+/* A piece of copying for one thread */
+typedef struct {
+   unsigned long long in_off;
+   unsigned long long out_off;
+   unsigned long long len;
+} job;
+
+static int in_mode = -1;
+static int out_mode = -1;
+static const char *map_path = NULL;
+static int threads = 0;
+
+static lime_image image;
+static int out_fd = -1;
+static long page_size = 4096;
+
+static job *jobs = NULL;
+static int job_count = 0;
+static int job_size = 0;
+static int next_job = 0;
+static int failed = 0;
+static unsigned long long sparse_bytes = 0;
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void usage(void)
+{
+   fprintf(stdout, "LiME Image Converter\n");
+   fprintf(stdout, "Usage: %s [-h] [OPTIONS] [input] [output]\n", PROJECT_NAME);
+   fprintf(stdout, "\n");
+
+   fprintf(stdout, "  OPTIONS:\n");
+   fprintf(stdout, "   -h                    Show this help message and exit.\n");
+   fprintf(stdout, "   -I[raw|padded|lime]   Input format. LiME images are detected.\n");
+   fprintf(stdout, "   -f[raw|padded|lime]   Output format.\n");
+   fprintf(stdout, "   -m[file]              System RAM map of the capture: the output of \"lime -m\" or\n");
+   fprintf(stdout, "                         a copy of /proc/iomem. Raw input defaults to this device's\n");
+   fprintf(stdout, "                         /proc/iomem.\n");
+   fprintf(stdout, "   -j[threads]           Number of copying threads (default: one per CPU).\n");
+   fprintf(stdout, "\n");
+   fprintf(stdout, "  Raw images need the map to recover addresses. Padded images use it to skip\n");
+   fprintf(stdout, "  holes, without one the whole image is converted. Zero pages are left as holes\n");
+   fprintf(stdout, "  in the output, which must be a file other than the input.\n");
+}
+
+static int parse_format(const char *name)
+{
+   int mode = parse_image_format(name);
+
+   if (mode < 0)
+   {
+      fprintf(stderr, "Unknown format: %s\n", name);
+      usage();
+      exit(EXIT_FAILURE);
+   }
+
+   return mode;
+}
+
+static void add_job(unsigned long long in_off, unsigned long long out_off, unsigned long long len)
+{
+   unsigned long long n;
+
+   for (; len; len -= n, in_off += n, out_off += n)
+   {
+      n = len < CONVERT_CHUNK ? len : CONVERT_CHUNK;
+
+      if (job_count == job_size)
+         jobs = lime_grow(jobs, &job_size, sizeof(job));
+
+      jobs[job_count].in_off = in_off;
+      jobs[job_count].out_off = out_off;
+      jobs[job_count].len = n;
+      job_count++;
+   }
+}
+
+static void write_all(const void *v, size_t len, unsigned long long off)
+{
+   ssize_t s;
+
+   while (len)
+   {
+      s = pwrite(out_fd, v, len, off);
+
+      if (s < 0 && errno == EINTR)
+         continue;
+
+      if (s <= 0)
+      {
+         fprintf(stderr, "Error writing the output: %s\n", strerror(errno));
+         exit(EXIT_FAILURE);
+      }
+
+      v = (const char *)v + s;
+      len -= s;
+      off += s;
+   }
+}
+
+/* Lay the extents out in the output format. Returns the output size. */
+static unsigned long long plan_output(void)
+{
+   const lime_extent *extents = image.extents;
+   lime_mem_range_header header;
+   unsigned long long out_off = 0;
+   int i, j;
+
+   for (i = 0; i < image.count; i = j)
+   {
+      // Extents that touch become one LiME range
+      for (j = i + 1; j < image.count && extents[j].start == extents[j - 1].end + 1; j++)
+         ;
+
+      if (out_mode == LIME_MODE_LIME)
+      {
+         memset(&header, 0, sizeof(header));
+         header.magic = LIME_MAGIC;
+         header.version = 1;
+         header.s_addr = extents[i].start;
+         header.e_addr = extents[j - 1].end;
+
+         write_all(&header, sizeof(header), out_off);
+         out_off += sizeof(header);
+      }
+
+      for (; i < j; i++)
+      {
+         if (out_mode == LIME_MODE_PADDED)
+            out_off = extents[i].start;
+
+         add_job(extents[i].in_off, out_off, extents[i].end - extents[i].start + 1);
+         out_off += extents[i].end - extents[i].start + 1;
+      }
+   }
+
+   return out_off;
+}
+
+static int is_zero(const char *v, size_t len)
+{
+   const unsigned long *w = (const unsigned long *)v;
+   size_t i;
+
+   for (i = 0; i < len / sizeof(*w); i++)
+      if (w[i])
+         return 0;
+
+   for (i = len - len % sizeof(*w); i < len; i++)
+      if (v[i])
+         return 0;
+
+   return 1;
+}
+
+/* Copy one job, skipping zero pages so they stay holes in the output. */
+static unsigned long long run_job(const job *j)
+{
+   unsigned long long zero = 0;
+   size_t pos, run = 0, n;
+   const char *v;
+
+   v = map_image(&image, j->in_off, j->len);
+
+   for (pos = 0; pos < j->len; pos += n)
+   {
+      n = j->len - pos < (size_t)page_size ? j->len - pos : (size_t)page_size;
+
+      if (is_zero(v + pos, n))
+      {
+         if (run)
+            write_all(v + pos - run, run, j->out_off + pos - run);
+
+         run = 0;
+         zero += n;
+      }
+      else
+         run += n;
+   }
+
+   if (run)
+      write_all(v + pos - run, run, j->out_off + pos - run);
+
+   unmap_image(v, j->in_off, j->len);
+
+   return zero;
+}
+
+static void *worker(void *arg)
+{
+   unsigned long long zero = 0;
+   int i;
+
+   for (;;)
+   {
+      pthread_mutex_lock(&job_lock);
+      i = failed ? job_count : next_job++;
+      pthread_mutex_unlock(&job_lock);
+
+      if (i >= job_count)
+         break;
+
+      zero += run_job(&jobs[i]);
+   }
+
+   pthread_mutex_lock(&job_lock);
+   sparse_bytes += zero;
+   pthread_mutex_unlock(&job_lock);
+
+   return NULL;
+}
+
+static void parse_args(int argc, char *argv[], const char **in, const char **out)
+{
+   int n;
+
+   for (n = 1; n < argc; n++)
+   {
+      if (argv[n][0] != '-')
+      {
+         if (!*in)
+            *in = argv[n];
+         else if (!*out)
+            *out = argv[n];
+         else
+         {
+            usage();
+            exit(EXIT_FAILURE);
+         }
+
+         continue;
+      }
+
+      switch (argv[n][1])
+      {
+         case 'h':
+            usage();
+            exit(EXIT_SUCCESS);
+
+         case 'I':
+            in_mode = parse_format(&argv[n][2]);
+            break;
+
+         case 'f':
+            out_mode = parse_format(&argv[n][2]);
+            break;
+
+         case 'm':
+            if (!argv[n][2])
+            {
+               fprintf(stderr, "Argument \"-m\" requires a file!\n");
+               exit(EXIT_FAILURE);
+            }
+
+            map_path = &argv[n][2];
+            break;
+
+         case 'j':
+            threads = atoi(&argv[n][2]);
+
+            if (threads <= 0 || threads > CONVERT_MAX_THREADS)
+            {
+               fprintf(stderr, "Argument \"-j\" requires 1 to %d threads!\n", CONVERT_MAX_THREADS);
+               exit(EXIT_FAILURE);
+            }
+            break;
+
+         default:
+            fprintf(stderr, "Unknown flag = %c\n", argv[n][1]);
+            usage();
+            exit(EXIT_FAILURE);
+      }
+   }
+}
+
+int convert_main(int argc, char *argv[])
+{
+   const char *in = NULL, *out = NULL;
+   pthread_t tids[CONVERT_MAX_THREADS];
+   unsigned long long out_size;
+   struct stat st, in_st;
+   int i;
+
+   parse_args(argc, argv, &in, &out);
+
+   if (!in || !out || out_mode < 0)
+   {
+      fprintf(stderr, "An input, an output and an output format (\"-f\") are required!\n");
+      usage();
+      exit(EXIT_FAILURE);
+   }
+
+   page_size = sysconf(_SC_PAGESIZE);
+   open_image(&image, in, in_mode, map_path);
+
+   // Opening the input as the output would truncate it before it is read
+   if (fstat(image.fd, &in_st) == 0 && stat(out, &st) == 0 &&
+       st.st_dev == in_st.st_dev && st.st_ino == in_st.st_ino)
+   {
+      fprintf(stderr, "The output can't be the input!\n");
+      exit(EXIT_FAILURE);
+   }
+
+   if ((out_fd = open(out, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0 || fstat(out_fd, &st) != 0)
+   {
+      fprintf(stderr, "Couldn't open %s: %s\n", out, strerror(errno));
+      exit(EXIT_FAILURE);
+   }
+
+   // Holes and parallel writes need a seekable output
+   if (!S_ISREG(st.st_mode))
+   {
+      fprintf(stderr, "The output must be a regular file!\n");
+      exit(EXIT_FAILURE);
+   }
+
+   out_size = plan_output();
+
+   if (!threads)
+   {
+      threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+      threads = threads < 1 ? 1 : (threads > CONVERT_MAX_THREADS ? CONVERT_MAX_THREADS : threads);
+   }
+
+   for (i = 0; i < threads; i++)
+   {
+      if (pthread_create(&tids[i], NULL, worker, NULL) != 0)
+      {
+         fprintf(stderr, "Couldn't start a copying thread!\n");
+         pthread_mutex_lock(&job_lock);
+         failed = 1;
+         pthread_mutex_unlock(&job_lock);
+         break;
+      }
+   }
+
+   while (i--)
+      pthread_join(tids[i], NULL);
+
+   // Zero pages at the end were never written
+   if (failed || ftruncate(out_fd, out_size) != 0 || close(out_fd) != 0)
+   {
+      fprintf(stderr, "Error finishing %s\n", out);
+      exit(EXIT_FAILURE);
+   }
+
+   fprintf(stdout, "Wrote %llu bytes, %llu bytes of zero pages left sparse.\n", out_size, sparse_bytes);
+
+   close_image(&image);
+   free(jobs);
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,223 @@
+/*
+ * "limedecrypt" - Decrypt LiME images encrypted in the kernel
+ * Copyright (c) 2013 Jake Valletta
+ *
+ *
+ * Author:
+ * Jake Valletta     -javallet@gmail.com, @jake_valletta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/evp.h>
+
+#include <jakev/lime.h>
+
+#define PROJECT_NAME "limedecrypt"
+
+static unsigned char key[LIME_KEY_SIZE];
+
+static void usage(void)
+{
+   fprintf(stdout, "LiME Image Decryptor\n");
+   fprintf(stdout, "Usage: %s -K[hex|@file] [input] [output]\n", PROJECT_NAME);
+   fprintf(stdout, "\n");
+   fprintf(stdout, "  Decrypts an image written with \"lime -c\". Every frame is authenticated;\n");
+   fprintf(stdout, "  a damaged, reordered or truncated image is reported and the output is\n");
+   fprintf(stdout, "  not to be trusted past that point.\n");
+}
+
+static int parse_key(const char *arg)
+{
+   unsigned int i, byte;
+   FILE *fp;
+
+   if (arg[0] == '@')
+   {
+      fp = fopen(&arg[1], "rb");
+
+      if (!fp)
+         return -1;
+
+      i = fread(key, 1, LIME_KEY_SIZE, fp);
+      fclose(fp);
+
+      return (i == LIME_KEY_SIZE) ? 0 : -1;
+   }
+
+   if (strlen(arg) != LIME_KEY_SIZE * 2)
+      return -1;
+
+   for (i = 0; i < LIME_KEY_SIZE; i++)
+   {
+      if (sscanf(&arg[i * 2], "%2x", &byte) != 1)
+         return -1;
+
+      key[i] = (unsigned char)byte;
+   }
+
+   return 0;
+}
+
+static const EVP_CIPHER *get_cipher(unsigned int cipher)
+{
+   switch (cipher)
+   {
+      case LIME_CIPHER_AES_GCM:
+         return EVP_aes_256_gcm();
+
+#ifdef NID_chacha20_poly1305
+      case LIME_CIPHER_CHACHA20_POLY1305:
+         return EVP_chacha20_poly1305();
+#endif
+
+      default:
+         return NULL;
+   }
+}
+
+static int decrypt(FILE *in, FILE *out)
+{
+   lime_crypt_header header;
+   lime_crypt_frame frame;
+   const EVP_CIPHER *cipher;
+   EVP_CIPHER_CTX *ctx;
+   unsigned char iv[12], *buf, *plain;
+   unsigned int index = 0, len;
+   int outl, final = 0, ret_val = -1;
+
+   if (fread(&header, sizeof(header), 1, in) != 1 || header.magic != LIME_CRYPT_MAGIC)
+   {
+      fprintf(stderr, "Not an encrypted LiME image!\n");
+      return -1;
+   }
+
+   if (!(cipher = get_cipher(header.cipher)))
+   {
+      fprintf(stderr, "Unsupported cipher: %u\n", header.cipher);
+      return -1;
+   }
+
+   buf = malloc(header.frame_size + LIME_CRYPT_TAG);
+   plain = malloc(header.frame_size + EVP_MAX_BLOCK_LENGTH);
+   ctx = EVP_CIPHER_CTX_new();
+
+   if (!buf || !plain || !ctx)
+   {
+      fprintf(stderr, "Out of memory!\n");
+      goto out;
+   }
+
+   while (!final && fread(&frame, sizeof(frame), 1, in) == 1)
+   {
+      final = (frame.len & LIME_CRYPT_FINAL) != 0;
+      len = frame.len & ~LIME_CRYPT_FINAL;
+
+      if (frame.index != index || len > header.frame_size)
+      {
+         fprintf(stderr, "Frame %u is out of sequence or damaged!\n", index);
+         goto out;
+      }
+
+      if (fread(buf, 1, len + LIME_CRYPT_TAG, in) != len + LIME_CRYPT_TAG)
+         break;
+
+      // Salt followed by the big endian frame index
+      memcpy(iv, header.salt, sizeof(header.salt));
+      iv[8] = index >> 24;
+      iv[9] = index >> 16;
+      iv[10] = index >> 8;
+      iv[11] = index;
+
+      if (EVP_DecryptInit_ex(ctx, cipher, NULL, NULL, NULL) != 1 ||
+          EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_IVLEN, sizeof(iv), NULL) != 1 ||
+          EVP_DecryptInit_ex(ctx, NULL, NULL, key, iv) != 1 ||
+          EVP_DecryptUpdate(ctx, NULL, &outl, (unsigned char *)&frame, sizeof(frame)) != 1 ||
+          EVP_DecryptUpdate(ctx, plain, &outl, buf, len) != 1 ||
+          EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, LIME_CRYPT_TAG, buf + len) != 1 ||
+          EVP_DecryptFinal_ex(ctx, plain + outl, &outl) != 1)
+      {
+         fprintf(stderr, "Frame %u failed authentication (wrong key or damaged image)!\n", index);
+         goto out;
+      }
+
+      if (fwrite(plain, 1, len, out) != len)
+      {
+         fprintf(stderr, "Error writing output!\n");
+         goto out;
+      }
+
+      index++;
+   }
+
+   if (!final)
+   {
+      fprintf(stderr, "Image is truncated after frame %u!\n", index);
+      goto out;
+   }
+
+   ret_val = 0;
+
+out:
+   if (ctx)
+      EVP_CIPHER_CTX_free(ctx);
+   free(plain);
+   free(buf);
+
+   return ret_val;
+}
+
+int main(int argc, char *argv[])
+{
+   FILE *in, *out;
+   int ret_val;
+
+   if (argc != 4 || strncmp(argv[1], "-K", 2) != 0)
+   {
+      usage();
+      exit(EXIT_FAILURE);
+   }
+
+   if (parse_key(&argv[1][2]) != 0)
+   {
+      fprintf(stderr, "The key must be %d hex digits or a file holding %d bytes!\n",
+              LIME_KEY_SIZE * 2, LIME_KEY_SIZE);
+      exit(EXIT_FAILURE);
+   }
+
+   in = fopen(argv[2], "rb");
+   out = fopen(argv[3], "wb");
+
+   if (!in || !out)
+   {
+      fprintf(stderr, "Couldn't open %s!\n", !in ? argv[2] : argv[3]);
+      exit(EXIT_FAILURE);
+   }
+
+   ret_val = decrypt(in, out);
+
+   memset(key, 0, sizeof(key));
+   fclose(in);
+
+   if (fclose(out) != 0)
+      ret_val = -1;
+
+   if (ret_val < 0)
+      exit(EXIT_FAILURE);
+
+   fprintf(stdout, "Done!\n");
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,500 @@
+/*
+ * "lime diff" - Find the pages that changed between two LiME images
+ * Copyright (c) 2013 Jake Valletta
+ *
+ *
+ * Author:
+ * Jake Valletta     -javallet@gmail.com, @jake_valletta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include <jakev/lime.h>
+
+#include "lime_image.h"
+
+#define PROJECT_NAME "lime diff"
+
+/* Work is handed to the threads in pieces of this size, so at most
+ * 2 * threads * DIFF_CHUNK of the images is mapped at any time. */
+#define DIFF_CHUNK       (4 << 20)
+#define DIFF_MAX_THREADS 16
+
+/* A stretch of memory present in both images */
+typedef struct {
+   unsigned long long addr;
+   unsigned long long old_off;
+   unsigned long long new_off;
+   unsigned long long len;
+} job;
+
+static int in_mode = -1;
+static const char *map_path = NULL;
+static int threads = 0;
+
+static lime_image old_image;
+static lime_image new_image;
+static unsigned int page_shift = 12;
+
+static unsigned char *bitmap = NULL;
+static unsigned long long base_pfn = 0;
+static unsigned long long pfn_count = 0;
+
+static job *jobs = NULL;
+static int job_count = 0;
+static int job_size = 0;
+static int next_job = 0;
+static int failed = 0;
+static unsigned long long compared = 0;
+static unsigned long long compared_bytes = 0;
+static unsigned long long changed = 0;
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void usage(void)
+{
+   fprintf(stdout, "LiME Image Differ\n");
+   fprintf(stdout, "Usage: %s [-h] [OPTIONS] [old] [new] [bitmap]\n", PROJECT_NAME);
+   fprintf(stdout, "\n");
+
+   fprintf(stdout, "  OPTIONS:\n");
+   fprintf(stdout, "   -h                    Show this help message and exit.\n");
+   fprintf(stdout, "   -I[raw|padded|lime]   Format of both images. LiME images are detected.\n");
+   fprintf(stdout, "   -m[file]              System RAM map for raw and padded images, as for \"lime convert\".\n");
+   fprintf(stdout, "   -j[threads]           Number of comparing threads (default: one per CPU).\n");
+   fprintf(stdout, "\n");
+   fprintf(stdout, "  Pages are matched by physical address. A page is changed if its contents\n");
+   fprintf(stdout, "  differ or only one image holds it. The optional bitmap file gets a\n");
+   fprintf(stdout, "  lime_diff_header and a bit per page frame, least significant bit first.\n");
+   fprintf(stdout, "  The page size comes from the images' boot or pfn records, 4K without them.\n");
+}
+
+static inline int page_equal(const char *a, const char *b, size_t len)
+{
+   size_t i = 0;
+
+#if defined(__SSE2__)
+   const __m128i zero = _mm_setzero_si128();
+   __m128i x;
+
+   for (; i + 64 <= len; i += 64)
+   {
+      x = _mm_or_si128(_mm_or_si128(_mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + i)),
+                                                  _mm_loadu_si128((const __m128i *)(b + i))),
+                                    _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + i + 16)),
+                                                  _mm_loadu_si128((const __m128i *)(b + i + 16)))),
+                       _mm_or_si128(_mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + i + 32)),
+                                                  _mm_loadu_si128((const __m128i *)(b + i + 32))),
+                                    _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + i + 48)),
+                                                  _mm_loadu_si128((const __m128i *)(b + i + 48)))));
+
+      if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, zero)) != 0xffff)
+         return 0;
+   }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+   const unsigned char *ua = (const unsigned char *)a, *ub = (const unsigned char *)b;
+   uint64x2_t w;
+
+   for (; i + 64 <= len; i += 64)
+   {
+      w = vreinterpretq_u64_u8(vorrq_u8(vorrq_u8(veorq_u8(vld1q_u8(ua + i), vld1q_u8(ub + i)),
+                                                 veorq_u8(vld1q_u8(ua + i + 16), vld1q_u8(ub + i + 16))),
+                                        vorrq_u8(veorq_u8(vld1q_u8(ua + i + 32), vld1q_u8(ub + i + 32)),
+                                                 veorq_u8(vld1q_u8(ua + i + 48), vld1q_u8(ub + i + 48)))));
+
+      if (vgetq_lane_u64(w, 0) | vgetq_lane_u64(w, 1))
+         return 0;
+   }
+#endif
+
+   return memcmp(a + i, b + i, len - i) == 0;
+}
+
+/* Set the bit for a page frame. Returns 1 if it wasn't already set. */
+static inline int mark_pfn(unsigned long long pfn)
+{
+   unsigned long long i = pfn - base_pfn;
+   unsigned char bit = 1 << (i & 7);
+
+   return !(__sync_fetch_and_or(&bitmap[i >> 3], bit) & bit);
+}
+
+static unsigned long long mark_pages(unsigned long long start, unsigned long long end)
+{
+   unsigned long long pfn, n = 0;
+
+   for (pfn = start >> page_shift; pfn <= end >> page_shift; pfn++)
+      n += mark_pfn(pfn);
+
+   return n;
+}
+
+/* Mark the memory in img that other doesn't hold. Returns the pages marked. */
+static unsigned long long mark_only(const lime_image *img, const lime_image *other)
+{
+   const lime_extent *x, *o;
+   unsigned long long cur, n = 0;
+   int i, k = 0, m, done;
+
+   for (i = 0; i < img->count; i++)
+   {
+      x = &img->extents[i];
+      cur = x->start;
+      done = 0;
+
+      for (; k < other->count && other->extents[k].end < x->start; k++)
+         ;
+
+      for (m = k; m < other->count && other->extents[m].start <= x->end; m++)
+      {
+         o = &other->extents[m];
+
+         if (o->start > cur)
+            n += mark_pages(cur, o->start - 1);
+
+         if (o->end >= x->end)
+         {
+            done = 1;
+            break;
+         }
+
+         cur = o->end + 1;
+      }
+
+      if (!done)
+         n += mark_pages(cur, x->end);
+   }
+
+   return n;
+}
+
+static void add_job(unsigned long long addr, unsigned long long old_off, unsigned long long new_off,
+                    unsigned long long len)
+{
+   unsigned long long n;
+
+   compared_bytes += len;
+
+   for (; len; len -= n, addr += n, old_off += n, new_off += n)
+   {
+      // Cut at chunk boundaries in memory so no page is split between two jobs
+      n = DIFF_CHUNK - (addr & (DIFF_CHUNK - 1));
+      n = len < n ? len : n;
+
+      if (job_count == job_size)
+         jobs = lime_grow(jobs, &job_size, sizeof(job));
+
+      jobs[job_count].addr = addr;
+      jobs[job_count].old_off = old_off;
+      jobs[job_count].new_off = new_off;
+      jobs[job_count].len = n;
+      job_count++;
+   }
+}
+
+/* Walk both extent lists and queue up the memory they share. */
+static void plan_diff(void)
+{
+   const lime_extent *a = old_image.extents, *b = new_image.extents;
+   unsigned long long start, end;
+   int i = 0, j = 0;
+
+   while (i < old_image.count && j < new_image.count)
+   {
+      start = a[i].start > b[j].start ? a[i].start : b[j].start;
+      end = a[i].end < b[j].end ? a[i].end : b[j].end;
+
+      if (start <= end)
+         add_job(start, a[i].in_off + (start - a[i].start), b[j].in_off + (start - b[j].start), end - start + 1);
+
+      if (a[i].end < b[j].end)
+         i++;
+      else
+         j++;
+   }
+}
+
+static void run_job(const job *j, unsigned long long *pages, unsigned long long *diffs)
+{
+   unsigned long long page = 1ULL << page_shift, addr, n;
+   const char *a, *b;
+   size_t pos;
+
+   a = map_image(&old_image, j->old_off, j->len);
+   b = map_image(&new_image, j->new_off, j->len);
+
+   for (pos = 0; pos < j->len; pos += n)
+   {
+      addr = j->addr + pos;
+      n = page - (addr & (page - 1));
+      n = j->len - pos < n ? j->len - pos : n;
+
+      if (!page_equal(a + pos, b + pos, n))
+         *diffs += mark_pfn(addr >> page_shift);
+
+      (*pages)++;
+   }
+
+   unmap_image(a, j->old_off, j->len);
+   unmap_image(b, j->new_off, j->len);
+}
+
+static void *worker(void *arg)
+{
+   unsigned long long pages = 0, diffs = 0;
+   int i;
+
+   for (;;)
+   {
+      pthread_mutex_lock(&job_lock);
+      i = failed ? job_count : next_job++;
+      pthread_mutex_unlock(&job_lock);
+
+      if (i >= job_count)
+         break;
+
+      run_job(&jobs[i], &pages, &diffs);
+   }
+
+   pthread_mutex_lock(&job_lock);
+   compared += pages;
+   changed += diffs;
+   pthread_mutex_unlock(&job_lock);
+
+   return NULL;
+}
+
+static void setup_bitmap(void)
+{
+   unsigned long long first = ~0ULL, last = 0;
+
+   if (old_image.count)
+   {
+      first = old_image.extents[0].start;
+      last = old_image.extents[old_image.count - 1].end;
+   }
+
+   if (new_image.count)
+   {
+      first = new_image.extents[0].start < first ? new_image.extents[0].start : first;
+      last = new_image.extents[new_image.count - 1].end > last ? new_image.extents[new_image.count - 1].end : last;
+   }
+
+   if (first > last)
+   {
+      fprintf(stderr, "Neither image holds any memory!\n");
+      exit(EXIT_FAILURE);
+   }
+
+   base_pfn = first >> page_shift;
+   pfn_count = (last >> page_shift) - base_pfn + 1;
+
+   if (!(bitmap = calloc((pfn_count + 7) / 8, 1)))
+   {
+      fprintf(stderr, "Out of memory!\n");
+      exit(EXIT_FAILURE);
+   }
+}
+
+static void write_bitmap(const char *out)
+{
+   lime_diff_header header;
+   FILE *fp;
+
+   memset(&header, 0, sizeof(header));
+   header.magic = LIME_DIFF_MAGIC;
+   header.version = 1;
+   header.page_shift = page_shift;
+   header.base_pfn = base_pfn;
+   header.pfn_count = pfn_count;
+
+   if (!(fp = fopen(out, "wb")) || fwrite(&header, sizeof(header), 1, fp) != 1 ||
+       fwrite(bitmap, 1, (pfn_count + 7) / 8, fp) != (pfn_count + 7) / 8 || fclose(fp) != 0)
+   {
+      fprintf(stderr, "Error writing %s: %s\n", out, strerror(errno));
+      exit(EXIT_FAILURE);
+   }
+}
+
+static void parse_args(int argc, char *argv[], const char **old, const char **new, const char **out)
+{
+   int n;
+
+   for (n = 1; n < argc; n++)
+   {
+      if (argv[n][0] != '-')
+      {
+         if (!*old)
+            *old = argv[n];
+         else if (!*new)
+            *new = argv[n];
+         else if (!*out)
+            *out = argv[n];
+         else
+         {
+            usage();
+            exit(EXIT_FAILURE);
+         }
+
+         continue;
+      }
+
+      switch (argv[n][1])
+      {
+         case 'h':
+            usage();
+            exit(EXIT_SUCCESS);
+
+         case 'I':
+            if ((in_mode = parse_image_format(&argv[n][2])) < 0)
+            {
+               fprintf(stderr, "Unknown format: %s\n", &argv[n][2]);
+               usage();
+               exit(EXIT_FAILURE);
+            }
+            break;
+
+         case 'm':
+            if (!argv[n][2])
+            {
+               fprintf(stderr, "Argument \"-m\" requires a file!\n");
+               exit(EXIT_FAILURE);
+            }
+
+            map_path = &argv[n][2];
+            break;
+
+         case 'j':
+            threads = atoi(&argv[n][2]);
+
+            if (threads <= 0 || threads > DIFF_MAX_THREADS)
+            {
+               fprintf(stderr, "Argument \"-j\" requires 1 to %d threads!\n", DIFF_MAX_THREADS);
+               exit(EXIT_FAILURE);
+            }
+            break;
+
+         default:
+            fprintf(stderr, "Unknown flag = %c\n", argv[n][1]);
+            usage();
+            exit(EXIT_FAILURE);
+      }
+   }
+}
+
+int diff_main(int argc, char *argv[])
+{
+   const char *old = NULL, *new = NULL, *out = NULL;
+   pthread_t tids[DIFF_MAX_THREADS];
+   unsigned long long only_old, only_new, total = 0, i;
+   struct timespec t0, t1;
+   double secs;
+   int t;
+
+   parse_args(argc, argv, &old, &new, &out);
+
+   if (!old || !new)
+   {
+      fprintf(stderr, "Two images are required!\n");
+      usage();
+      exit(EXIT_FAILURE);
+   }
+
+   open_image(&old_image, old, in_mode, map_path);
+   open_image(&new_image, new, in_mode, map_path);
+
+   // Page frames are the capturing kernel's, not this machine's
+   if (old_image.page_shift && new_image.page_shift && old_image.page_shift != new_image.page_shift)
+   {
+      fprintf(stderr, "The images were taken with different page sizes!\n");
+      exit(EXIT_FAILURE);
+   }
+
+   page_shift = old_image.page_shift ? old_image.page_shift : (new_image.page_shift ? new_image.page_shift : 12);
+
+   setup_bitmap();
+
+   // Memory captured in one image only counts as changed
+   only_old = mark_only(&old_image, &new_image);
+   only_new = mark_only(&new_image, &old_image);
+
+   plan_diff();
+
+   if (!threads)
+   {
+      threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+      threads = threads < 1 ? 1 : (threads > DIFF_MAX_THREADS ? DIFF_MAX_THREADS : threads);
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &t0);
+
+   for (t = 0; t < threads; t++)
+   {
+      if (pthread_create(&tids[t], NULL, worker, NULL) != 0)
+      {
+         fprintf(stderr, "Couldn't start a comparing thread!\n");
+         pthread_mutex_lock(&job_lock);
+         failed = 1;
+         pthread_mutex_unlock(&job_lock);
+         break;
+      }
+   }
+
+   while (t--)
+      pthread_join(tids[t], NULL);
+
+   clock_gettime(CLOCK_MONOTONIC, &t1);
+
+   if (failed)
+      exit(EXIT_FAILURE);
+
+   for (i = 0; i < (pfn_count + 7) / 8; i++)
+      total += __builtin_popcount(bitmap[i]);
+
+   secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+   fprintf(stdout, "Compared %llu pages in %.2f seconds (%.1f MB/s per image).\n", compared, secs,
+           secs > 0 ? compared_bytes / secs / (1 << 20) : 0.0);
+   fprintf(stdout, "  Changed:      %llu\n", changed);
+   fprintf(stdout, "  Only in old:  %llu\n", only_old);
+   fprintf(stdout, "  Only in new:  %llu\n", only_new);
+   fprintf(stdout, "  Total:        %llu of %llu page frames (pfn 0x%llx-0x%llx)\n", total, pfn_count, base_pfn,
+           base_pfn + pfn_count - 1);
+
+   if (out)
+   {
+      write_bitmap(out);
+      fprintf(stdout, "Wrote the changed page bitmap to %s\n", out);
+   }
+
+   close_image(&old_image);
+   close_image(&new_image);
+   free(bitmap);
+   free(jobs);
+
+   return EXIT_SUCCESS;
+}
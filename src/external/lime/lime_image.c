@@ -0,0 +1,361 @@
+/*
+ * "lime" - Reading LiME images for the offline modes
+ * Copyright (c) 2013 Jake Valletta
+ *
+ *
+ * Author:
+ * Jake Valletta     -javallet@gmail.com, @jake_valletta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <jakev/lime.h>
+
+#include "lime_image.h"
+
+int parse_image_format(const char *name)
+{
+   if (strcmp(name, "raw") == 0)
+      return LIME_MODE_RAW;
+   else if (strcmp(name, "padded") == 0)
+      return LIME_MODE_PADDED;
+   else if (strcmp(name, "lime") == 0)
+      return LIME_MODE_LIME;
+
+   return -1;
+}
+
+void *lime_grow(void *v, int *size, size_t elem)
+{
+   *size = *size ? *size * 2 : 64;
+   v = realloc(v, *size * elem);
+
+   if (!v)
+   {
+      fprintf(stderr, "Out of memory!\n");
+      exit(EXIT_FAILURE);
+   }
+
+   return v;
+}
+
+static void insert_extent(lime_image *img, int i, unsigned long long start, unsigned long long end,
+                          unsigned long long in_off)
+{
+   if (img->count == img->cap)
+      img->extents = lime_grow(img->extents, &img->cap, sizeof(lime_extent));
+
+   memmove(&img->extents[i + 1], &img->extents[i], (img->count - i) * sizeof(lime_extent));
+
+   img->extents[i].start = start;
+   img->extents[i].end = end;
+   img->extents[i].in_off = in_off;
+   img->count++;
+}
+
+/* Add the parts of [start, end] that no extent covers yet. Pieces added
+ * first win, so callers go from the newest copy of memory to the oldest. */
+static void add_uncovered(lime_image *img, unsigned long long start, unsigned long long end,
+                          unsigned long long in_off)
+{
+   unsigned long long cur = start;
+   int i;
+
+   for (i = 0; i < img->count && cur <= end; i++)
+   {
+      if (img->extents[i].end < cur)
+         continue;
+
+      if (img->extents[i].start > end)
+         break;
+
+      if (img->extents[i].start > cur)
+      {
+         insert_extent(img, i, cur, img->extents[i].start - 1, in_off + (cur - start));
+         i++;
+      }
+
+      cur = img->extents[i].end + 1;
+   }
+
+   if (cur <= end)
+      insert_extent(img, i, cur, end, in_off + (cur - start));
+}
+
+static int cmp_range(const void *a, const void *b)
+{
+   const lime_range *ra = a, *rb = b;
+
+   return (ra->start > rb->start) - (ra->start < rb->start);
+}
+
+/* Read "System RAM" ranges from "lime -m" output or from /proc/iomem. */
+static lime_range *load_map(const char *map_path, int *count)
+{
+   const char *path = map_path ? map_path : "/proc/iomem";
+   lime_range *map = NULL;
+   int size = 0, n;
+   char line[256];
+   FILE *fp;
+
+   *count = 0;
+
+   if (!(fp = fopen(path, "r")))
+   {
+      fprintf(stderr, "Couldn't open the range map %s: %s\n", path, strerror(errno));
+      exit(EXIT_FAILURE);
+   }
+
+   while (fgets(line, sizeof(line), fp))
+   {
+      if (*count == size)
+         map = lime_grow(map, &size, sizeof(lime_range));
+
+      // "lime -m" prints 0x<start>-0x<end>
+      if (sscanf(line, "0x%llx-0x%llx", &map[*count].start, &map[*count].end) == 2)
+      {
+         (*count)++;
+         continue;
+      }
+
+      // Only top level entries of /proc/iomem are RAM, nested ones are kernel sections
+      n = 0;
+      if (line[0] != ' ' && sscanf(line, "%llx-%llx : %n", &map[*count].start, &map[*count].end, &n) == 2 &&
+          n && strncmp(&line[n], LIME_RAMSTR, strlen(LIME_RAMSTR)) == 0)
+         (*count)++;
+   }
+
+   fclose(fp);
+
+   if (*count == 0)
+   {
+      fprintf(stderr, "No System RAM ranges found in %s\n", path);
+      exit(EXIT_FAILURE);
+   }
+
+   qsort(map, *count, sizeof(lime_range), cmp_range);
+
+   return map;
+}
+
+/* Pick up the capturing kernel's page size from a record that has it */
+static void read_page_shift(lime_image *img, const lime_meta_header *meta, unsigned long long off)
+{
+   unsigned int shift = 0;
+   size_t at;
+
+   if (img->page_shift)
+      return;
+
+   if (meta->type == LIME_META_BOOT && meta->size >= sizeof(lime_boot_entry))
+      at = offsetof(lime_boot_entry, page_shift);
+   else if (meta->type == LIME_META_PFN && meta->size >= sizeof(lime_pfn_header))
+      at = offsetof(lime_pfn_header, page_shift);
+   else
+      return;
+
+   if (pread(img->fd, &shift, sizeof(shift), off + sizeof(*meta) + at) == sizeof(shift) && shift >= 12 && shift < 32)
+      img->page_shift = shift;
+}
+
+static void read_lime_image(lime_image *img)
+{
+   lime_mem_range_header header;
+   lime_meta_header meta;
+   unsigned long long off = 0, len;
+   lime_extent *pieces = NULL;
+   int i, count = 0, size = 0;
+
+   while (off + sizeof(header) <= img->size)
+   {
+      if (pread(img->fd, &header, sizeof(header), off) != sizeof(header))
+      {
+         fprintf(stderr, "Error reading the image: %s\n", strerror(errno));
+         exit(EXIT_FAILURE);
+      }
+
+      if (header.magic == LIME_META_MAGIC)
+      {
+         // Metadata records hold no memory
+         memcpy(&meta, &header, sizeof(meta));
+         read_page_shift(img, &meta, off);
+         off += sizeof(meta) + meta.size;
+         continue;
+      }
+
+      if (header.magic != LIME_MAGIC || header.e_addr < header.s_addr)
+      {
+         fprintf(stderr, "Corrupt LiME image at offset %llu\n", off);
+         exit(EXIT_FAILURE);
+      }
+
+      len = header.e_addr - header.s_addr + 1;
+      off += sizeof(header);
+
+      if (off + len > img->size)
+      {
+         fprintf(stderr, "The image is truncated, the last range is cut short.\n");
+         len = img->size - off;
+      }
+
+      if (len)
+      {
+         if (count == size)
+            pieces = lime_grow(pieces, &size, sizeof(lime_extent));
+
+         pieces[count].start = header.s_addr;
+         pieces[count].end = header.s_addr + len - 1;
+         pieces[count].in_off = off;
+         count++;
+      }
+
+      off += len;
+   }
+
+   // Later ranges (recaptures, the RAM pass after triage) are the newer copy
+   for (i = count - 1; i >= 0; i--)
+      add_uncovered(img, pieces[i].start, pieces[i].end, pieces[i].in_off);
+
+   free(pieces);
+}
+
+static void read_mapped_image(lime_image *img, const char *map_path)
+{
+   unsigned long long off = 0, len;
+   lime_range *map;
+   int i, count;
+
+   // A padded image holds its own addresses, the map only tells us where the holes are
+   if (img->mode == LIME_MODE_PADDED && !map_path)
+   {
+      add_uncovered(img, 0, img->size - 1, 0);
+      return;
+   }
+
+   map = load_map(map_path, &count);
+
+   for (i = 0; i < count; i++)
+   {
+      if (img->mode == LIME_MODE_PADDED)
+         off = map[i].start;
+
+      if (off >= img->size)
+         break;
+
+      len = map[i].end - map[i].start + 1;
+
+      if (off + len > img->size)
+         len = img->size - off;
+
+      add_uncovered(img, map[i].start, map[i].start + len - 1, off);
+
+      if (img->mode == LIME_MODE_RAW)
+         off += len;
+   }
+
+   if (img->mode == LIME_MODE_RAW && off != img->size)
+      fprintf(stderr, "Warning: the map describes %llu bytes but the image has %llu.\n", off, img->size);
+
+   free(map);
+}
+
+void open_image(lime_image *img, const char *path, int mode, const char *map_path)
+{
+   unsigned int magic = 0;
+   struct stat st;
+
+   memset(img, 0, sizeof(*img));
+   img->mode = mode;
+
+   if ((img->fd = open(path, O_RDONLY)) < 0 || fstat(img->fd, &st) != 0)
+   {
+      fprintf(stderr, "Couldn't open %s: %s\n", path, strerror(errno));
+      exit(EXIT_FAILURE);
+   }
+
+   img->size = st.st_size;
+
+   if (img->size == 0)
+   {
+      fprintf(stderr, "%s is empty!\n", path);
+      exit(EXIT_FAILURE);
+   }
+
+   if (pread(img->fd, &magic, sizeof(magic), 0) == sizeof(magic))
+   {
+      if (magic == LIME_CRYPT_MAGIC)
+      {
+         fprintf(stderr, "%s is encrypted, decrypt it with limedecrypt first.\n", path);
+         exit(EXIT_FAILURE);
+      }
+
+      if (img->mode < 0 && (magic == LIME_MAGIC || magic == LIME_META_MAGIC))
+         img->mode = LIME_MODE_LIME;
+   }
+
+   if (img->mode < 0)
+   {
+      fprintf(stderr, "%s is not a LiME image, give its format with \"-I\".\n", path);
+      exit(EXIT_FAILURE);
+   }
+
+   if (img->mode == LIME_MODE_LIME)
+      read_lime_image(img);
+   else
+      read_mapped_image(img, map_path);
+}
+
+void close_image(lime_image *img)
+{
+   close(img->fd);
+   free(img->extents);
+   memset(img, 0, sizeof(*img));
+}
+
+const char *map_image(const lime_image *img, unsigned long long off, size_t len)
+{
+   long page_size = sysconf(_SC_PAGESIZE);
+   unsigned long long base = off & ~(unsigned long long)(page_size - 1);
+   char *map;
+
+   map = mmap(NULL, len + (off - base), PROT_READ, MAP_PRIVATE, img->fd, base);
+
+   if (map == MAP_FAILED)
+   {
+      fprintf(stderr, "Error mapping the image: %s\n", strerror(errno));
+      exit(EXIT_FAILURE);
+   }
+
+   madvise(map, len + (off - base), MADV_SEQUENTIAL);
+
+   return map + (off - base);
+}
+
+void unmap_image(const char *v, unsigned long long off, size_t len)
+{
+   long page_size = sysconf(_SC_PAGESIZE);
+   size_t delta = off & (page_size - 1);
+
+   munmap((void *)(v - delta), len + delta);
+}
@@ -0,0 +1,62 @@
+/*
+ * "lime" - Reading LiME images for the offline modes
+ * Copyright (c) 2013 Jake Valletta
+ *
+ *
+ * Author:
+ * Jake Valletta     -javallet@gmail.com, @jake_valletta
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef LIME_IMAGE_H
+#define LIME_IMAGE_H
+
+#include <stddef.h>
+
+/* A run of physical memory and where its bytes are in the image */
+typedef struct {
+   unsigned long long start;
+   unsigned long long end;       /* Inclusive */
+   unsigned long long in_off;
+} lime_extent;
+
+/* An image opened for reading, with its contents as sorted,
+ * non-overlapping extents of physical memory */
+typedef struct {
+   int fd;
+   int mode;                     /* LIME_MODE_* */
+   unsigned long long size;
+   lime_extent *extents;
+   int count;
+   int cap;
+   unsigned int page_shift;      /* From a boot or pfn record, 0 if none */
+} lime_image;
+
+/* Returns the LIME_MODE_* for a format name, or -1 */
+int parse_image_format(const char *);
+
+/* Open an image of the given mode (-1 to detect a LiME image). Raw
+ * images take their addresses from the map file ("lime -m" output or a
+ * copy of /proc/iomem, NULL for this device's /proc/iomem). Padded images
+ * only use it to skip holes and are taken whole without one. Exits on
+ * error, like the rest of the command line tool. */
+void open_image(lime_image *, const char *, int, const char *);
+void close_image(lime_image *);
+
+/* Map len bytes of the image from offset off, read only */
+const char *map_image(const lime_image *, unsigned long long, size_t);
+void unmap_image(const char *, unsigned long long, size_t);
+
+void *lime_grow(void *, int *, size_t);
+
+#endif
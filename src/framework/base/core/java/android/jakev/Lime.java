@@ -20,6 +20,8 @@
  */
 package android.jakev;
 
+import android.os.ParcelFileDescriptor;
+
 /**
  * API for interacting with LiME Forensics.
  *
@@ -168,7 +170,69 @@ public final class Lime {
                 return dump_memory_port(port, mode, dio);
         }
 
+
+	/* File Descriptor Dumps */
+	/**
+	 * Dump memory to a file descriptor the caller already has open.
+	 *
+	 * This method will use <code>LIME_MODE_RAW<code> for the mode.
+	 *
+	 * @param pfd A writable, blocking descriptor: a file, pipe, connected socket or memfd.
+	 * @return The return value from the LiME Forensics kernel module.
+	 */
+	public static int dumpMemoryToFileDescriptor(ParcelFileDescriptor pfd) {
+		return dump_memory_fd(pfd.getFd(), LIME_MODE_RAW);
+	}
+
+	/**
+	 * Dump memory to a file descriptor the caller already has open.
+	 *
+	 * The kernel writes the image straight into the descriptor, so there
+	 * is no copy through userspace. The caller keeps ownership of
+	 * <code>pfd<code> and should close it afterwards.
+	 *
+	 * @param pfd A writable, blocking descriptor: a file, pipe, connected socket or memfd.
+	 * @param mode The output format for the memory dump.
+	 * @return The return value from the LiME Forensics kernel module.
+	 */
+	public static int dumpMemoryToFileDescriptor(ParcelFileDescriptor pfd, int mode) {
+		return dump_memory_fd(pfd.getFd(), mode);
+	}
+
+
+	/* Process Dumps */
+	/**
+	 * Dump only the physical pages mapped by a set of processes to a file on disk.
+	 *
+	 * The output always uses <code>LIME_MODE_LIME<code>, and contains the
+	 * VMAs and virtual to physical mappings of each process alongside the pages.
+	 *
+	 * @param fileName The path to use for the memory dump file.
+	 * @param pids The process ids to dump (at most 16).
+	 * @return The return value from the LiME Forensics kernel module.
+	 */
+	public static int dumpProcessesToDisk(String fileName, int[] pids) {
+		return dump_proc_disk(fileName, LIME_DIO_ENABLED, pids);
+	}
+
+	/**
+	 * Dump only the physical pages mapped by a set of processes to a specified TCP port.
+	 *
+	 * The output always uses <code>LIME_MODE_LIME<code>, and contains the
+	 * VMAs and virtual to physical mappings of each process alongside the pages.
+	 *
+	 * @param port The TCP port to dump memory to.
+	 * @param pids The process ids to dump (at most 16).
+	 * @return The return value from the LiME Forensics kernel module.
+	 */
+	public static int dumpProcessesToPort(int port, int[] pids) {
+		return dump_proc_port(port, LIME_DIO_ENABLED, pids);
+	}
+
        	/** @hide */ public static native int dump_memory_disk(String file_name, int mode, int dio);
 	/** @hide */ public static native int dump_memory_port(int port, int mode, int dio);
+	/** @hide */ public static native int dump_memory_fd(int fd, int mode);
+	/** @hide */ public static native int dump_proc_disk(String file_name, int dio, int[] pids);
+	/** @hide */ public static native int dump_proc_port(int port, int dio, int[] pids);
 	/** @hide */ public static native boolean is_ready();
 }
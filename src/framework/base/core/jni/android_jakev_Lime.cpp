@@ -72,6 +72,46 @@ static jint android_jakev_Lime_dump_memory_port(JNIEnv * env, jobject clazz, jin
    return __dump_memory_tcp((int)port, (int)mode, (int)dio);
 }
 
+/*
+ * Dump memory to a file descriptor owned by the caller.
+ */
+static jint android_jakev_Lime_dump_memory_fd(JNIEnv * env, jobject clazz, jint fd, jint mode)
+{
+   return __dump_memory_fd((int)fd, (int)mode, NULL);
+}
+
+/*
+ * Dump the pages mapped by a set of processes to a file on disk.
+ */
+static jint android_jakev_Lime_dump_proc_disk(JNIEnv* env, jobject clazz, jstring file_name, jint dio, jintArray pids)
+{
+   int ret_val;
+   const char *tmp = env->GetStringUTFChars(file_name, NULL);
+   jint *elems = env->GetIntArrayElements(pids, NULL);
+
+   ret_val = __dump_memory_proc_disk(tmp, LIME_MODE_LIME, (int)dio, (const int *)elems, env->GetArrayLength(pids), NULL);
+
+   env->ReleaseIntArrayElements(pids, elems, JNI_ABORT);
+   env->ReleaseStringUTFChars(file_name, tmp);
+
+   return ret_val;
+}
+
+/*
+ * Dump the pages mapped by a set of processes to a specified TCP port.
+ */
+static jint android_jakev_Lime_dump_proc_port(JNIEnv* env, jobject clazz, jint port, jint dio, jintArray pids)
+{
+   int ret_val;
+   jint *elems = env->GetIntArrayElements(pids, NULL);
+
+   ret_val = __dump_memory_proc_tcp((int)port, LIME_MODE_LIME, (int)dio, (const int *)elems, env->GetArrayLength(pids), NULL);
+
+   env->ReleaseIntArrayElements(pids, elems, JNI_ABORT);
+
+   return ret_val;
+}
+
 /*
  * JNI registration.
  */
@@ -80,6 +120,9 @@ static JNINativeMethod gMethods[] = {
    { "is_ready",      "()Z", (void*) android_jakev_Lime_is_ready },
    { "dump_memory_disk",  "(Ljava/lang/String;II)I", (void*) android_jakev_Lime_dump_memory_disk },
    { "dump_memory_port",  "(III)I", (void*) android_jakev_Lime_dump_memory_port }, 
+   { "dump_memory_fd",  "(II)I", (void*) android_jakev_Lime_dump_memory_fd },
+   { "dump_proc_disk",  "(Ljava/lang/String;I[I)I", (void*) android_jakev_Lime_dump_proc_disk },
+   { "dump_proc_port",  "(II[I)I", (void*) android_jakev_Lime_dump_proc_port },
 };
 
 int register_android_jakev_Lime(JNIEnv* env)
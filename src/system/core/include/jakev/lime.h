@@ -22,7 +22,9 @@
 #include <sys/ioctl.h>
 
 /* From LiME "lime.h" */
+#define LIME_RAMSTR "System RAM"
 #define LIME_MAX_FILENAME_SIZE 256
+#define LIME_MAGIC 0x4C694D45 //LiME
 
 #define LIME_MODE_RAW 0
 #define LIME_MODE_LIME 1
@@ -31,6 +33,7 @@
 #define LIME_METHOD_UNKNOWN 0
 #define LIME_METHOD_TCP 1
 #define LIME_METHOD_DISK 2
+#define LIME_METHOD_FD 3
 /* End from "lime.h" */
 
 #define LIME_DEVICE     "lime"
@@ -38,8 +41,74 @@
 
 /* LiME device ioctl definitions */
 #define LIME_GET_STATUS         _IO(__LIMEIO, 1) /* Get status of driver */
-#define LIME_DUMP_TCP           _IO(__LIMEIO, 2) /* Dump memory to socket */
-#define LIME_DUMP_DISK          _IO(__LIMEIO, 3) /* Dump memory to disk */
+#define LIME_DUMP_TCP           _IOW(__LIMEIO, 2, lime_dump_tcp) /* Dump memory to socket */
+#define LIME_DUMP_DISK          _IOW(__LIMEIO, 3, lime_dump_disk) /* Dump memory to disk */
+#define LIME_DUMP_PROC          _IOW(__LIMEIO, 4, lime_dump_proc) /* Dump pages mapped by processes */
+#define LIME_GET_RAM_MAP        _IOR(__LIMEIO, 5, lime_ram_map) /* Describe "System RAM" */
+#define LIME_DUMP_FD            _IOW(__LIMEIO, 6, lime_dump_fd) /* Dump memory to an open fd */
+
+#define LIME_MAX_PIDS           16
+#define LIME_MAX_RANGES         64
+
+/* LiME metadata records (LIME_MODE_LIME only) */
+#define LIME_META_MAGIC         0x4C694D4D
+
+#define LIME_META_VMA           1
+#define LIME_META_PTE           2
+#define LIME_META_HITS          3
+#define LIME_META_ENTROPY       4
+#define LIME_META_SMEAR         5
+#define LIME_META_PFN           6
+#define LIME_META_BOOT          7
+#define LIME_META_ZRAM          8
+
+#define LIME_META_TRUNCATED     0x1
+
+#define LIME_SEGMENT_SIZE       (4 << 20)
+#define LIME_CHUNK_SIZE         (64 << 10)
+
+/* Content classes in lime_entropy_entry */
+#define LIME_CONTENT_ZERO       0
+#define LIME_CONTENT_TEXT       1
+#define LIME_CONTENT_CODE       2
+#define LIME_CONTENT_DATA       3
+#define LIME_CONTENT_COMPRESSED 4
+#define LIME_CONTENT_ENCRYPTED  5
+
+/* Page classes in a LIME_META_PFN record */
+#define LIME_PFN_OTHER          0
+#define LIME_PFN_KERNEL         1
+#define LIME_PFN_SLAB           2
+#define LIME_PFN_ANON           3
+#define LIME_PFN_FILE           4
+#define LIME_PFN_FREE           5
+
+#define LIME_MAX_PATTERNS       16
+#define LIME_MAX_PATTERN_LEN    64
+
+/* Triage modes */
+#define LIME_TRIAGE_OFF         0
+#define LIME_TRIAGE_FIRST       1
+#define LIME_TRIAGE_ONLY        2
+
+/* Acquisition orders */
+#define LIME_ORDER_PHYSICAL     0
+#define LIME_ORDER_VOLATILITY   1
+
+/* Stream ciphers */
+#define LIME_CIPHER_NONE                0
+#define LIME_CIPHER_AES_GCM             1
+#define LIME_CIPHER_CHACHA20_POLY1305   2
+
+#define LIME_KEY_SIZE           32
+
+/* Range classes, stored in reserved[0] of a LiME range header */
+#define LIME_RANGE_RAM          0
+#define LIME_RANGE_KTEXT        1
+#define LIME_RANGE_KDATA        2
+#define LIME_RANGE_SLAB         3
+#define LIME_RANGE_KRODATA      4
+#define LIME_RANGE_RECAPTURE    5
 
 /* LiME device statuses */
 #define LIME_STATUS_READY       0x1
@@ -50,10 +119,55 @@ extern "C" {
 #endif
 
 /* Structs */
+typedef struct {
+        unsigned int magic;
+        unsigned int version;
+        unsigned long long s_addr;
+        unsigned long long e_addr;
+        unsigned char reserved[8];
+} __attribute__ ((__packed__)) lime_mem_range_header;
+
+typedef struct {
+        unsigned int len;
+        unsigned char data[LIME_MAX_PATTERN_LEN];
+} lime_pattern;
+
+typedef struct {
+        unsigned long long start;
+        unsigned long long end;         /* Inclusive */
+} lime_range;
+
+typedef struct {
+        int count;
+        lime_range ranges[LIME_MAX_RANGES];
+        unsigned long long size_raw;    /* Expected image size per format */
+        unsigned long long size_padded;
+        unsigned long long size_lime;
+} lime_ram_map;
+
+typedef struct {
+        int triage;
+        int pattern_count;
+        lime_pattern patterns[LIME_MAX_PATTERNS];
+        int entropy;
+        int smear;
+        int order;
+        int cipher;
+        unsigned char key[LIME_KEY_SIZE];
+        int window_count;               /* Only dump "System RAM" inside these */
+        lime_range windows[LIME_MAX_RANGES];
+        int pfn_meta;                   /* Emit LIME_META_PFN records */
+        int boot;                       /* Emit a LIME_META_BOOT record first */
+        int zram;                       /* Index zram objects, record swap ptes */
+
+} lime_dump_opts;
+
 typedef struct {
         char file_name[LIME_MAX_FILENAME_SIZE];
         int mode;
 	int dio;
+        lime_dump_opts opts;
+        unsigned long long segment_size;
 
 } lime_dump_disk;
 
@@ -62,13 +176,164 @@ typedef struct {
         int port;
         int mode;
 	int dio;
+        lime_dump_opts opts;
 
 } lime_dump_tcp;
 
+typedef struct {
+        int fd;
+        int mode;
+        lime_dump_opts opts;
+
+} lime_dump_fd;
+
+typedef struct {
+        int method;
+        char file_name[LIME_MAX_FILENAME_SIZE];
+        int port;
+        int mode;
+	int dio;
+        int pid_count;
+        int pids[LIME_MAX_PIDS];
+        lime_dump_opts opts;
+
+} lime_dump_proc;
+
+typedef struct {
+        unsigned int magic;
+        unsigned int version;
+        unsigned int type;
+        unsigned int flags;
+        unsigned long long size;
+        unsigned char reserved[8];
+} __attribute__ ((__packed__)) lime_meta_header;
+
+typedef struct {
+        int pid;
+        unsigned int flags;
+        unsigned long long start;
+        unsigned long long end;
+        unsigned long long pgoff;
+} __attribute__ ((__packed__)) lime_vma_entry;
+
+/* Swap ptes: flags holds LIME_PTE_SWAP and the swap type, paddr the offset */
+#define LIME_PTE_SWAP           0x1
+#define LIME_PTE_SWAP_TYPE(f)   ((f) >> 8)
+
+typedef struct {
+        int pid;
+        unsigned int flags;
+        unsigned long long vaddr;
+        unsigned long long paddr;
+} __attribute__ ((__packed__)) lime_pte_entry;
+
+typedef struct {
+        unsigned long long paddr;
+        unsigned int pattern;
+        unsigned int reserved;
+} __attribute__ ((__packed__)) lime_hit_entry;
+
+typedef struct {
+        unsigned long long paddr;
+        unsigned int size;
+        unsigned short entropy;
+        unsigned char zero;
+        unsigned char class;
+} __attribute__ ((__packed__)) lime_entropy_entry;
+
+typedef struct {
+        unsigned long long paddr;
+        unsigned int size;
+        unsigned int captured;
+        unsigned int recaptured;
+        unsigned int reserved;
+} __attribute__ ((__packed__)) lime_smear_entry;
+
+/* Followed by the columns flags[count] (u32), mapcount[count] (s32),
+ * order[count] (u8) and class[count] (u8), for pfn .. pfn + count - 1 */
+typedef struct {
+        unsigned long long pfn;
+        unsigned int count;
+        unsigned int page_shift;
+} __attribute__ ((__packed__)) lime_pfn_header;
+
+#define LIME_BANNER_SIZE        256
+
+typedef struct {
+        unsigned long long pgd_paddr;
+        unsigned long long page_offset;
+        unsigned long long text_vaddr;
+        unsigned long long text_paddr;
+        unsigned long long kaslr_offset;
+        unsigned long long init_task_vaddr;
+        unsigned long long init_task_paddr;
+        unsigned int page_shift;
+        unsigned int pointer_size;
+        char banner[LIME_BANNER_SIZE];
+} __attribute__ ((__packed__)) lime_boot_entry;
+
+#define LIME_ZRAM_ZERO          0x1
+#define LIME_ZRAM_SPLIT         0x2
+
+typedef struct {
+        unsigned int device;
+        unsigned int count;
+        int swap_type;
+        char compressor[16];
+} __attribute__ ((__packed__)) lime_zram_header;
+
+typedef struct {
+        unsigned long long paddr;
+        unsigned int index;
+        unsigned int size;
+        unsigned short flags;
+        unsigned short reserved;
+} __attribute__ ((__packed__)) lime_zram_entry;
+
+/* Encrypted streams */
+#define LIME_CRYPT_MAGIC        0x4C694D43
+#define LIME_CRYPT_FRAME        (64 << 10)
+#define LIME_CRYPT_FINAL        0x80000000
+#define LIME_CRYPT_TAG          16
+
+typedef struct {
+        unsigned int magic;
+        unsigned int version;
+        unsigned int cipher;
+        unsigned int frame_size;
+        unsigned char salt[8];
+        unsigned char reserved[8];
+} __attribute__ ((__packed__)) lime_crypt_header;
+
+typedef struct {
+        unsigned int index;
+        unsigned int len;
+} __attribute__ ((__packed__)) lime_crypt_frame;
+
+/* "lime diff" output: a bit per page frame from base_pfn, set when the
+ * page differs between the two images or is only in one of them */
+#define LIME_DIFF_MAGIC         0x4C694D44
+
+typedef struct {
+        unsigned int magic;
+        unsigned int version;
+        unsigned int page_shift;
+        unsigned int reserved;
+        unsigned long long base_pfn;
+        unsigned long long pfn_count;
+} __attribute__ ((__packed__)) lime_diff_header;
+
 /* Function Prototypes */
 int __is_ready();
+int __get_ram_map(lime_ram_map *);
 int __dump_memory_disk(const char *, int, int);
 int __dump_memory_tcp(int, int, int);
+int __dump_memory_disk_opts(const char *, int, int, const lime_dump_opts *);
+int __dump_memory_disk_segmented(const char *, int, int, unsigned long long, const lime_dump_opts *);
+int __dump_memory_tcp_opts(int, int, int, const lime_dump_opts *);
+int __dump_memory_fd(int, int, const lime_dump_opts *);
+int __dump_memory_proc_disk(const char *, int, int, const int *, int, const lime_dump_opts *);
+int __dump_memory_proc_tcp(int, int, int, const int *, int, const lime_dump_opts *);
 
 #ifdef __cplusplus
 }
@@ -31,6 +31,17 @@
 #include <sys/ioctl.h>		/* ioctl */
 
 /* Internal Implementation Functions */
+
+/* Requests can carry the stream key. A memset() of a dying local may be
+ * dropped by the compiler, so clear them through a volatile pointer. */
+static void __wipe(void *v, size_t len)
+{
+        volatile unsigned char *p = v;
+
+        while (len--)
+                *p++ = 0;
+}
+
 static int __is_ready_kernel() 
 {
         int file_desc, ret_val;
@@ -56,7 +67,33 @@ out:
 	return ret_val;
 }
 
-static int __dump_memory_disk_kernel(const char *file_name, int mode, int dio) 
+static int __get_ram_map_kernel(lime_ram_map *map)
+{
+        int file_desc, ret_val;
+
+        file_desc = open("/dev/"LIME_DEVICE, 0);
+
+	if (file_desc < 0)
+	{
+                LOGE("Error opening LiME device!\n");
+        	ret_val = -1;
+		goto out;
+	}
+
+        ret_val = ioctl(file_desc, LIME_GET_RAM_MAP, map);
+
+        if (ret_val < 0) {
+                LOGE("Error with ioctl?: %d\n", ret_val);
+	}
+
+        close(file_desc);
+
+out:
+	return ret_val;
+}
+
+static int __dump_memory_disk_kernel(const char *file_name, int mode, int dio, unsigned long long segment_size,
+                                     const lime_dump_opts *opts) 
 {
 	int file_desc, ret_val;
 	lime_dump_disk ldd;
@@ -70,14 +107,18 @@ static int __dump_memory_disk_kernel(const char *file_name, int mode, int dio)
 		goto out;
 	}
 	
-	
-	strncpy(ldd.file_name, file_name, strlen(file_name));
-	ldd.file_name[strlen(file_name)] = '\0';
+	memset(&ldd, 0, sizeof(ldd));
+	strncpy(ldd.file_name, file_name, LIME_MAX_FILENAME_SIZE - 1);
 	
 	ldd.mode = mode;
 	ldd.dio = dio;
+	ldd.segment_size = segment_size;
+
+	if (opts)
+		ldd.opts = *opts;
 
 	ret_val = ioctl(file_desc, LIME_DUMP_DISK, &ldd);
+	__wipe(&ldd, sizeof(ldd));
 	
 	if (ret_val < 0)
 	{
@@ -90,7 +131,7 @@ out:
 	return ret_val;	
 }
 
-static int __dump_memory_tcp_kernel(int port_number, int mode, int dio)
+static int __dump_memory_tcp_kernel(int port_number, int mode, int dio, const lime_dump_opts *opts)
 {
         int file_desc, ret_val;
         lime_dump_tcp ldt;
@@ -104,11 +145,51 @@ static int __dump_memory_tcp_kernel(int port_number, int mode, int dio)
                 goto out;
         }
 
+        memset(&ldt, 0, sizeof(ldt));
 	ldt.port = port_number;
         ldt.mode = mode;
         ldt.dio = dio;
 
+        if (opts)
+                ldt.opts = *opts;
+
         ret_val = ioctl(file_desc, LIME_DUMP_TCP, &ldt);
+        __wipe(&ldt, sizeof(ldt));
+
+        if (ret_val < 0)
+        {
+                LOGE("Dump memory failed: %d\n", ret_val);
+        }
+
+        close(file_desc);
+
+out:
+        return ret_val;
+}
+
+static int __dump_memory_fd_kernel(int fd, int mode, const lime_dump_opts *opts)
+{
+        int file_desc, ret_val;
+        lime_dump_fd ldf;
+
+        file_desc = open("/dev/"LIME_DEVICE, 0);
+
+        if (file_desc < 0)
+        {
+                LOGE("Error opening LiME device!\n");
+		ret_val = -1;
+                goto out;
+        }
+
+        memset(&ldf, 0, sizeof(ldf));
+        ldf.fd = fd;
+        ldf.mode = mode;
+
+        if (opts)
+                ldf.opts = *opts;
+
+        ret_val = ioctl(file_desc, LIME_DUMP_FD, &ldf);
+        __wipe(&ldf, sizeof(ldf));
 
         if (ret_val < 0)
         {
@@ -121,18 +202,112 @@ out:
         return ret_val;
 }
 
+static int __dump_memory_proc_kernel(lime_dump_proc *ldp, const int *pids, int pid_count, const lime_dump_opts *opts)
+{
+        int file_desc, ret_val;
+
+        if (pid_count <= 0 || pid_count > LIME_MAX_PIDS)
+        {
+                LOGE("Invalid number of processes: %d\n", pid_count);
+                ret_val = -1;
+                goto out;
+        }
+
+        file_desc = open("/dev/"LIME_DEVICE, 0);
+
+        if (file_desc < 0)
+        {
+                LOGE("Error opening LiME device!\n");
+                ret_val = -1;
+                goto out;
+        }
+
+        ldp->pid_count = pid_count;
+        memcpy(ldp->pids, pids, pid_count * sizeof(int));
+
+        if (opts)
+                ldp->opts = *opts;
+
+        ret_val = ioctl(file_desc, LIME_DUMP_PROC, ldp);
+        __wipe(ldp, sizeof(*ldp));
+
+        if (ret_val < 0)
+        {
+                LOGE("Dump processes failed: %d\n", ret_val);
+        }
+
+        close(file_desc);
+
+out:
+        return ret_val;
+}
+
 /* Exposed Functions */
 int __is_ready()
 {
 	return  __is_ready_kernel();
 }
 
+int __get_ram_map(lime_ram_map *map)
+{
+	return __get_ram_map_kernel(map);
+}
+
 int __dump_memory_disk(const char *filename, int mode, int dio)
 {
-	return __dump_memory_disk_kernel(filename, mode, dio);
+	return __dump_memory_disk_kernel(filename, mode, dio, 0, NULL);
 }
 
 int __dump_memory_tcp(int port_number, int mode, int dio)
 {
-        return __dump_memory_tcp_kernel(port_number, mode, dio);
+        return __dump_memory_tcp_kernel(port_number, mode, dio, NULL);
+}
+
+int __dump_memory_disk_opts(const char *filename, int mode, int dio, const lime_dump_opts *opts)
+{
+	return __dump_memory_disk_kernel(filename, mode, dio, 0, opts);
+}
+
+int __dump_memory_disk_segmented(const char *filename, int mode, int dio, unsigned long long segment_size,
+                                 const lime_dump_opts *opts)
+{
+	return __dump_memory_disk_kernel(filename, mode, dio, segment_size, opts);
+}
+
+int __dump_memory_tcp_opts(int port_number, int mode, int dio, const lime_dump_opts *opts)
+{
+        return __dump_memory_tcp_kernel(port_number, mode, dio, opts);
+}
+
+int __dump_memory_fd(int fd, int mode, const lime_dump_opts *opts)
+{
+        return __dump_memory_fd_kernel(fd, mode, opts);
+}
+
+int __dump_memory_proc_disk(const char *filename, int mode, int dio, const int *pids, int pid_count, const lime_dump_opts *opts)
+{
+        lime_dump_proc ldp;
+
+        memset(&ldp, 0, sizeof(ldp));
+        strncpy(ldp.file_name, filename, LIME_MAX_FILENAME_SIZE - 1);
+
+        ldp.method = LIME_METHOD_DISK;
+        ldp.mode = mode;
+        ldp.dio = dio;
+
+        return __dump_memory_proc_kernel(&ldp, pids, pid_count, opts);
+}
+
+int __dump_memory_proc_tcp(int port_number, int mode, int dio, const int *pids, int pid_count, const lime_dump_opts *opts)
+{
+        lime_dump_proc ldp;
+
+        memset(&ldp, 0, sizeof(ldp));
+
+        ldp.method = LIME_METHOD_TCP;
+        ldp.port = port_number;
+        ldp.mode = mode;
+        ldp.dio = dio;
+
+        return __dump_memory_proc_kernel(&ldp, pids, pid_count, opts);
 }